@@ -1,12 +1,15 @@
 #ifdef linux
 #include <string.h>
 #endif
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #include "corona.h"
 
 #include "Canvas.h"
+#include "memstats.h"
 #include "utility.h"
 
 namespace Blitter {
@@ -29,12 +32,68 @@ namespace Blitter {
         }
     }
 
-    void AlphaMask(Canvas& src) {
-        RGBA* sourcePixel  = src.GetPixels(); // + (ystart * src.Width()) + xstart;
-        for (int i=0; i<src.Width()*src.Height(); i++) {
-            sourcePixel->a = max(max(sourcePixel->r, sourcePixel->g), sourcePixel->b);
-            sourcePixel++;
+    uint BandCount(int width, int height) {
+        const uint threads = Parallel::ThreadCount();
+        if (threads < 2 || width < 1 || height < 2 || width * height < parallelThreshold) {
+            return 1;
         }
+        // A couple of bands per thread, so one slow band doesn't hold the rest up.
+        return min<uint>(threads * 2, height);
+    }
+
+    Rect Band(const Rect& area, uint index, uint count) {
+        const int height = area.Height();
+        return Rect(
+            area.left,  area.top + height * index / count,
+            area.right, area.top + height * (index + 1) / count);
+    }
+
+    void MakeSpans(std::vector<Span>& spans, Filter filter, int srcStart, int srcLength, int destLength, int destFirst, int count) {
+        spans.resize(count);
+        const int srcLast = srcStart + srcLength - 1;
+
+        for (int i = 0; i < count; i++) {
+            const s64 d = destFirst + i;
+            Span& span = spans[i];
+
+            if (filter == boxFilter) {
+                // Every source pixel falls in exactly one span when shrinking.  Enlarging gives one pixel each.
+                span.first = srcStart + int(d * srcLength / destLength);
+                span.last = max(span.first + 1, srcStart + int((d + 1) * srcLength / destLength));
+                span.weight = 0;
+            } else {
+                // Pixel centres line up: the centre of dest pixel d is at (d + 0.5) * srcLength / destLength in the source.
+                const s64 pos = ((2 * d + 1) * srcLength * 256 - destLength * 256) / (2 * destLength);     // 24.8 fixed point
+                if (pos < 0) {
+                    span.first = span.last = srcStart;
+                    span.weight = 0;
+                } else {
+                    span.first = min(srcStart + int(pos >> 8), srcLast);
+                    span.last = min(span.first + 1, srcLast);
+                    span.weight = int(pos & 255);
+                }
+            }
+        }
+    }
+
+    namespace {
+        struct AlphaMaskOp {
+            AlphaMaskOp(Canvas& c) : canvas(c) {}
+
+            void operator()(const Rect& band) const {
+                RGBA* sourcePixel = canvas.GetPixels() + band.top * canvas.Width();
+                RGBA* end = canvas.GetPixels() + band.bottom * canvas.Width();
+                for (; sourcePixel < end; sourcePixel++) {
+                    sourcePixel->a = max(max(sourcePixel->r, sourcePixel->g), sourcePixel->b);
+                }
+            }
+
+            Canvas& canvas;
+        };
+    }
+
+    void AlphaMask(Canvas& src) {
+        ForEachBand(Rect(0, 0, src.Width(), src.Height()), AlphaMaskOp(src));
     }    
 
     BlendType* GetBlender(int blendId) {
@@ -68,10 +127,81 @@ namespace Blitter {
 
 using Blitter::DoClipping;
 
+namespace {
+    // All pixel memory goes through these, so that it gets counted.
+    RGBA* NewPixels(int width, int height) {
+        MemStats::Allocate(MemStats::canvas, width * height * sizeof(RGBA));
+        return new RGBA[width * height];
+    }
+
+    void DeletePixels(RGBA* pixels, int width, int height) {
+        if (pixels) {
+            MemStats::Free(MemStats::canvas, width * height * sizeof(RGBA));
+            delete[] pixels;
+        }
+    }
+
+    // Row band workers for Blitter::ForEachBand.  Each only touches its own rows of dest.
+
+    struct CompareOp {
+        CompareOp(const RGBA* a, const RGBA* b, int w, std::vector<u8>& d) : lhs(a), rhs(b), width(w), differs(d) {}
+
+        void operator()(const Rect& band) const {
+            const int offset = band.top * width;
+            differs[band.top] = memcmp(lhs + offset, rhs + offset, band.Height() * width * sizeof(RGBA)) != 0;
+        }
+
+        const RGBA* lhs;
+        const RGBA* rhs;
+        const int width;
+        std::vector<u8>& differs;                               // by the first row of each band
+    };
+
+    struct ClearOp {
+        ClearOp(RGBA* p, int w, RGBA c) : pixels(p), width(w), colour(c) {}
+
+        void operator()(const Rect& band) const {
+            std::fill(pixels + band.top * width, pixels + band.bottom * width, colour);
+        }
+
+        RGBA* pixels;
+        const int width;
+        const RGBA colour;
+    };
+
+    /// 90 degrees clockwise: column x of the source, read bottom to top, becomes row x of dest.
+    struct RotateOp {
+        RotateOp(const RGBA* s, int w, int h, RGBA* d) : src(s), srcWidth(w), srcHeight(h), dest(d) {}
+
+        void operator()(const Rect& band) const {
+            for (int y = band.top; y < band.bottom; y++) {
+                RGBA* out = dest + y * srcHeight;
+                const RGBA* in = src + (srcHeight - 1) * srcWidth + y;
+                for (int x = 0; x < srcHeight; x++, in -= srcWidth) {
+                    *out++ = *in;
+                }
+            }
+        }
+
+        const RGBA* src;
+        const int srcWidth, srcHeight;
+        RGBA* dest;
+    };
+}
+
+PixelSlab::PixelSlab(uint count)
+    : pixels(NewPixels(count, 1))
+    , count(count)
+{}
+
+PixelSlab::~PixelSlab() {
+    DeletePixels(pixels, count, 1);
+}
+
 Canvas::Canvas() 
     : _width(16)
     , _height(16)
-    , _pixels(new RGBA[16 * 16])
+    , _pixels(NewPixels(16, 16))
     , _cliprect(0, 0, _width, _height)
 {
 }
@@ -79,7 +209,7 @@ Canvas::Canvas()
 Canvas::Canvas(int width, int height)
     : _width(width)
     , _height(height)
-    , _pixels(new RGBA[width * height])
+    , _pixels(NewPixels(width, height))
     , _cliprect(0, 0, width, height)
 {
     std::fill(_pixels, _pixels + _width * _height, RGBA(0, 0, 0, 0));
@@ -88,19 +218,28 @@ Canvas::Canvas(int width, int height)
 Canvas::Canvas(RGBA* pSrc, int width, int height)
     : _width(width)
     , _height(height)
-    , _pixels(new RGBA[width * height])
+    , _pixels(NewPixels(width, height))
     , _cliprect(0, 0, width, height)
 {
     memcpy(_pixels, pSrc, width * height * sizeof(RGBA));
 }
 
+Canvas::Canvas(PixelSlab* slab, uint offset, int width, int height)
+    : _width(width)
+    , _height(height)
+    , _pixels(slab->pixels + offset)
+    , _cliprect(0, 0, width, height)
+    , _slab(slab)
+{
+    assert(offset + width * height <= slab->count);
+}
+
 Canvas::Canvas(u8* data, int width, int height, u8* pal)
     : _width(width)
     , _height(height)
-    , _pixels(new RGBA[width * height])
+    , _pixels(NewPixels(width, height))
     , _cliprect(0, 0, width, height)
 {
-    _pixels = new RGBA[_width*_height];
     for (int i = 0; i < width * height; i++) {
         _pixels[i] = RGBA(data[i], pal);
     }
@@ -110,7 +249,7 @@ Canvas::Canvas(const Canvas& src) {
     _width = src._width;
     _height = src._height;
     
-    _pixels = new RGBA[_width*_height];
+    _pixels = NewPixels(_width, _height);
     std::copy(src._pixels, src._pixels + _width * _height, _pixels);
 
     _cliprect = Rect(0, 0, _width, _height);
@@ -127,7 +266,7 @@ Canvas::Canvas(const std::string& fname) {
     RGBA* src = (RGBA*)img->getPixels();
     _width  = img->getWidth();
     _height = img->getHeight();
-    _pixels = new RGBA[_width * _height];
+    _pixels = NewPixels(_width, _height);
     _cliprect = Rect(0, 0, _width, _height);
 
     std::copy(src, src + _width * _height, _pixels);
@@ -136,7 +275,16 @@ Canvas::Canvas(const std::string& fname) {
 }
 
 Canvas::~Canvas() {
-    delete[] _pixels;
+    FreePixels();
+}
+
+void Canvas::FreePixels() {
+    if (_slab) {
+        _slab = RefPtr<PixelSlab>();
+    } else {
+        DeletePixels(_pixels, _width, _height);
+    }
+    _pixels = 0;
 }
 
 
@@ -153,11 +301,11 @@ Canvas& Canvas::operator = (const Canvas& rhs) {
         return *this;
     }
     
-    delete[] _pixels;
+    FreePixels();
     
     _width = rhs._width;
     _height = rhs._height;
-    _pixels = new RGBA[_width*_height];
+    _pixels = NewPixels(_width, _height);
     memcpy(_pixels, rhs._pixels, _width*_height * sizeof(RGBA));
     
     return *this;
@@ -169,18 +317,24 @@ bool Canvas::operator == (const Canvas& rhs) {
     if (_height != rhs._height)
         return false;
     
-    return !memcmp(_pixels, rhs._pixels, _width*_height * sizeof(RGBA));
+    if (!_height) {
+        return true;
+    }
+
+    std::vector<u8> differs(_height);
+    Blitter::ForEachBand(Rect(0, 0, _width, _height), CompareOp(_pixels, rhs._pixels, _width, differs));
+    return std::find(differs.begin(), differs.end(), 1) == differs.end();
 }
 
 
 void Canvas::CopyPixelData(RGBA* data, int width, int height)
 {
-    delete[] _pixels;
+    FreePixels();
     
     _width = width;
     _height = height;
     
-    _pixels = new RGBA[width * height];
+    _pixels = NewPixels(width, height);
     memcpy(_pixels, data, width * height * sizeof(RGBA));
 
     _cliprect = Rect(0, 0, width, height);
@@ -188,12 +342,12 @@ void Canvas::CopyPixelData(RGBA* data, int width, int height)
 
 void Canvas::CopyPixelData(u8* data, int width, int height, u8* pal)
 {
-    delete[] _pixels;
+    FreePixels();
     
     _width = width;
     _height = height;
     
-    _pixels = new RGBA[width * height];
+    _pixels = NewPixels(width, height);
     for (int i = 0; i < width * height; i++)
         _pixels[i]=RGBA(data[i], pal);
 }
@@ -220,22 +374,31 @@ void Canvas::SetPixel(int x, int y, RGBA c)
 
 void Canvas::Clear(RGBA colour)
 {
-    // I feel like being nasty right now >:D
-    RGBA* p=_pixels+_width*_height - 1;
-    
-    while (p >=_pixels)
-        *p-- = colour;
+    Blitter::ForEachBand(Rect(0, 0, _width, _height), ClearOp(_pixels, _width, colour));
 }
 
 void Canvas::Rotate()
 {
-    Canvas temp(*this);
+    // The new image is _height wide and _width high.
+    RGBA* rotated = NewPixels(_height, _width);
+    Blitter::ForEachBand(Rect(0, 0, _height, _width), RotateOp(_pixels, _width, _height, rotated));
 
-    Resize(_height, _width);
-    
-    for (int y = 0; y<_height; y++)
-        for (int x = 0; x<_width; x++)
-            SetPixel(_height - y, x, temp.GetPixel(x, y));
+    FreePixels();
+    _pixels = rotated;
+    std::swap(_width, _height);
+    _cliprect = Rect(0, 0, _width, _height);
+}
+
+void Canvas::MakeMipChain(std::vector<Canvas*>& levels) const {
+    // ScaleBlit only reads the clip rect, so that's what gets halved.  The new levels clip to all of themselves.
+    const Canvas* level = this;
+    while (level->GetClipRect().Width() > 1 || level->GetClipRect().Height() > 1) {
+        const Rect& clip = level->GetClipRect();
+        Canvas* half = new Canvas(max(1, clip.Width() / 2), max(1, clip.Height() / 2));
+        Blitter::ScaleBlit(*level, *half, 0, 0, half->Width(), half->Height(), Blitter::boxFilter, Blitter::OpaqueBlend());
+        levels.push_back(half);
+        level = half;
+    }
 }
 
 void Canvas::Flip()
@@ -276,7 +439,7 @@ void Canvas::Resize(int x, int y)
     if (x < 1 || y < 1)
         return;
     
-    RGBA* pTemp = new RGBA[x * y];
+    RGBA* pTemp = NewPixels(x, y);
     
     RGBA* pSrc=_pixels;
     RGBA* pDest = pTemp;
@@ -290,7 +453,7 @@ void Canvas::Resize(int x, int y)
         pSrc += _width;
     }
     
-    delete[] _pixels;
+    FreePixels();
     _pixels = pTemp;
     _width = x;
     _height = y;
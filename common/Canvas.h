@@ -2,6 +2,20 @@
 
 #include "utility.h"
 #include "types.h"
+#include "refcount.h"
+
+/// One block of pixels that several Canvases look into.  A sprite's frames all live in one of these.
+struct PixelSlab : RefCounted {
+    explicit PixelSlab(uint count);
+    ~PixelSlab();
+
+    RGBA* const pixels;
+    const uint count;                                           ///< in pixels
+
+private:
+    PixelSlab(const PixelSlab&);
+    PixelSlab& operator = (const PixelSlab&);
+};
 
 /**
  *  Canvases are purely software representations of images.  Nothing more.
@@ -18,6 +32,7 @@ struct Canvas {
     Canvas(int width, int height);
     Canvas(u8* pData, int nWidth, int nHeight, u8* pal);
     Canvas(RGBA* pData, int nWidth, int nHeight);
+    Canvas(PixelSlab* slab, uint offset, int width, int height);   ///< A view of part of the slab.  Nothing is copied; drawing on the canvas changes the slab.
     Canvas(const Canvas& src);
     Canvas(const std::string& fname);
     ~Canvas();
@@ -44,6 +59,10 @@ struct Canvas {
     void Mirror();
     void Resize(int x, int y);
 
+    /// Appends successively half sized copies of the image (of its clip rect, for the first) to levels, down to 1x1.
+    /// Each pixel is the average of the 2x2 block above it.  The caller owns the new canvases.
+    void MakeMipChain(std::vector<Canvas*>& levels) const;
+
     const Rect& GetClipRect() const { return _cliprect; }
     void SetClipRect(const Rect& r);
 
@@ -51,6 +70,9 @@ private:
     int   _width, _height;                                      ///< Dimensions
 	RGBA* _pixels;                                              ///< Pointer to raw pixel data
     Rect _cliprect;                                             ///< Operations are restricted to this region of the image.
+    RefPtr<PixelSlab> _slab;                                    ///< If set, _pixels points into this, and isn't ours to delete.
+
+    void FreePixels();                                          ///< Deletes _pixels, or lets go of the slab.
 };
 
 #include "CanvasBlitter.h"
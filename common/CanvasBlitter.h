@@ -4,6 +4,7 @@
 // I may run into some problems with namespaces later on; the blending modes,
 // and the namespace 'Blitter' is general to the point of being vague.
 
+#include "thread.h"
 #include "types.h"
 #include "utility.h"
 
@@ -107,10 +108,47 @@ namespace Blitter {
     void DoClipping(int& x, int& y, int& xstart, int& xlen, int& ystart, int& ylen, const Rect& rClip);
     
     void AlphaMask(Canvas& src); 
-    
-    /// Renders an image on another image.
+
+    /**
+     * Big operations are split into bands of rows, and the bands are spread
+     * across the Parallel pool.  Each band does exactly what the whole
+     * operation would have done to those rows, so the result is the same no
+     * matter how many threads there are.
+     */
+    const int parallelThreshold = 256 * 256;                    ///< in pixels.  Anything smaller isn't worth waking the threads for.
+
+    uint BandCount(int width, int height);                      ///< How many bands an area should be split into.  1 if it's too small to bother.
+    Rect Band(const Rect& area, uint index, uint count);        ///< The index'th of count bands of rows of area.
+
+    template <typename Op>
+    struct BandTask : Parallel::Task {
+        BandTask(const Op& o, const Rect& a, uint c) : op(o), area(a), count(c) {}
+
+        virtual void Run(uint index) {
+            op(Band(area, index, count));
+        }
+
+        const Op& op;
+        const Rect area;
+        const uint count;
+    };
+
+    /// Calls op(band) for each band of area, on several threads if area is big enough.
+    template <typename Op>
+    void ForEachBand(const Rect& area, const Op& op) {
+        const uint count = BandCount(area.Width(), area.Height());
+        if (count < 2) {
+            op(area);
+            return;
+        }
+
+        BandTask<Op> task(op, area, count);
+        Parallel::For(task, count);
+    }
+
+    /// Renders an image on another image, touching only the pixels inside clip.  clip has to lie inside dest.
     template <typename Blender>
-    void Blit(const Canvas& src, Canvas& dest, int x, int y, const Blender& blend) {
+    void Blit(const Canvas& src, Canvas& dest, int x, int y, const Blender& blend, const Rect& clip) {
         const Rect& r = src.GetClipRect();
 
         int xstart = r.left;
@@ -118,7 +156,7 @@ namespace Blitter {
         int xlen = r.Width();
         int ylen = r.Height();
 
-        DoClipping(x, y, xstart, xlen, ystart, ylen, dest.GetClipRect());
+        DoClipping(x, y, xstart, xlen, ystart, ylen, clip);
         if (xlen < 1 || ylen < 1) {
             // completely clipped
             return;
@@ -143,9 +181,42 @@ namespace Blitter {
         }
     }
 
-    /// Renders an image on another image, stretching as necessary.
     template <typename Blender>
-    static void ScaleBlit(const Canvas& src, Canvas& dest, int cx, int cy, int w, int h, const Blender& blend) {
+    struct BlitOp {
+        BlitOp(const Canvas& s, Canvas& d, int _x, int _y, const Blender& b) : src(s), dest(d), x(_x), y(_y), blend(b) {}
+
+        void operator()(const Rect& band) const {
+            Blit(src, dest, x, y, blend, band);
+        }
+
+        const Canvas& src;
+        Canvas& dest;
+        const int x, y;
+        const Blender& blend;
+    };
+
+    /// Renders an image on another image.
+    template <typename Blender>
+    void Blit(const Canvas& src, Canvas& dest, int x, int y, const Blender& blend) {
+        const Rect& clip = dest.GetClipRect();
+
+        if (&src == &dest) {
+            // The bands would read each other's rows.
+            Blit(src, dest, x, y, blend, clip);
+            return;
+        }
+
+        const Rect& r = src.GetClipRect();
+        const Rect area(
+            max(clip.left, x), max(clip.top, y),
+            min(clip.right, x + r.Width()), min(clip.bottom, y + r.Height()));
+
+        ForEachBand(area, BlitOp<Blender>(src, dest, x, y, blend));
+    }
+
+    /// Renders an image on another image, stretching as necessary, touching only the pixels inside clip.
+    template <typename Blender>
+    static void ScaleBlit(const Canvas& src, Canvas& dest, int cx, int cy, int w, int h, const Blender& blend, const Rect& clip) {
         int x, y;               // current pixel position
         int ix, iy;             // current image location (fixed point 16.16)
         int xinc, yinc;         // Increment to ix, iy per screen pixel (fixed point)
@@ -168,7 +239,9 @@ namespace Blitter {
         xlen = w;
         ylen = h;
 
-        DoClipping(x, y, xstart, xlen, ystart, ylen, dest.GetClipRect());
+        // Everything below depends only on where the first row is, so a band
+        // of rows comes out exactly as it would as part of the whole image.
+        DoClipping(x, y, xstart, xlen, ystart, ylen, clip);
         if (xlen < 1 || ylen < 1)       return; // image is entirely offscreen
 
         int xs = xinc * xstart;
@@ -203,25 +276,205 @@ namespace Blitter {
     }
 
     template <typename Blender>
-    static void TileBlit(const Canvas& src, Canvas& dest, int startX, int startY, int w, int h, int offsetX, int offsetY, const Blender& blend) {
-        Rect oldClipRect = dest.GetClipRect();
-        dest.SetClipRect(Rect(startX, startY, startX + w, startY + h));
-
-        int curX = startX % src.Width() + offsetX;
-        int curY = startY % src.Height() + offsetY;
-        int lenX = w % src.Width();
-        int lenY = h % src.Height();
-
-        for (int y = 0; y < lenY; y++) {
-            for (int x = 0; x < lenX; x++) {
-                Blit(src, dest, curX, curY, blend);
-                curX += src.Width();
+    struct ScaleBlitOp {
+        ScaleBlitOp(const Canvas& s, Canvas& d, int _x, int _y, int _w, int _h, const Blender& b)
+            : src(s), dest(d), x(_x), y(_y), w(_w), h(_h), blend(b)
+        {}
+
+        void operator()(const Rect& band) const {
+            ScaleBlit(src, dest, x, y, w, h, blend, band);
+        }
+
+        const Canvas& src;
+        Canvas& dest;
+        const int x, y, w, h;
+        const Blender& blend;
+    };
+
+    /// Renders an image on another image, stretching as necessary.
+    template <typename Blender>
+    static void ScaleBlit(const Canvas& src, Canvas& dest, int cx, int cy, int w, int h, const Blender& blend) {
+        const Rect& clip = dest.GetClipRect();
+
+        if (&src == &dest) {
+            ScaleBlit(src, dest, cx, cy, w, h, blend, clip);
+            return;
+        }
+
+        const Rect area(
+            max(clip.left, cx), max(clip.top, cy),
+            min(clip.right, cx + w), min(clip.bottom, cy + h));
+
+        ForEachBand(area, ScaleBlitOp<Blender>(src, dest, cx, cy, w, h, blend));
+    }
+
+    /// How a filtered ScaleBlit works out each pixel.  Colours are weighted by alpha, so transparent pixels don't darken the edges of what they surround.
+    enum Filter {
+        nearestFilter,      ///< The closest source pixel.  Same as the plain ScaleBlit.
+        bilinearFilter,     ///< Blends the four closest source pixels.  Smooth when enlarging; shrinking to less than half size starts to skip pixels.
+        boxFilter,          ///< Averages every source pixel that lands on the dest pixel.  The one to use for shrinking.
+    };
+
+    /// Where one row or column of a filtered scale reads from.  Source coordinates, not relative to the clip rect.
+    struct Span {
+        int first;
+        int last;           ///< bilinear: the second pixel, and weight is how much of it to take, out of 256.  box: one past the last pixel.
+        int weight;
+    };
+
+    /// Works out the spans for dest pixels [destFirst, destFirst + count) of a srcLength -> destLength scale.
+    void MakeSpans(std::vector<Span>& spans, Filter filter, int srcStart, int srcLength, int destLength, int destFirst, int count);
+
+    inline RGBA BilinearSample(const RGBA* row0, const RGBA* row1, const Span& sx, int fy) {
+        const RGBA p[4] = { row0[sx.first], row0[sx.last], row1[sx.first], row1[sx.last] };
+        const uint fx = sx.weight;
+        const uint w[4] = { (256 - fx) * (256 - fy), fx * (256 - fy), (256 - fx) * fy, fx * fy };   // add up to 65536
+
+        uint a = 0, r = 0, g = 0, b = 0;
+        for (int i = 0; i < 4; i++) {
+            const uint aw = w[i] * p[i].a;
+            a += aw;
+            r += aw * p[i].r;
+            g += aw * p[i].g;
+            b += aw * p[i].b;
+        }
+
+        if (!a) {
+            // All transparent.  Keep the colour anyway, in case something uses it.
+            for (int i = 0; i < 4; i++) {
+                r += w[i] * p[i].r;
+                g += w[i] * p[i].g;
+                b += w[i] * p[i].b;
+            }
+            return RGBA((r + 32768) >> 16, (g + 32768) >> 16, (b + 32768) >> 16, 0);
+        }
+        return RGBA((r + a / 2) / a, (g + a / 2) / a, (b + a / 2) / a, (a + 32768) >> 16);
+    }
+
+    inline RGBA BoxSample(const Canvas& src, const Span& sx, const Span& sy) {
+        u64 a = 0, r = 0, g = 0, b = 0;
+        u64 plainR = 0, plainG = 0, plainB = 0;        // for when it's all transparent
+        for (int y = sy.first; y < sy.last; y++) {
+            const RGBA* p = src.GetPixels() + y * src.Width() + sx.first;
+            for (int x = sx.first; x < sx.last; x++, p++) {
+                a += p->a;
+                r += p->r * p->a;
+                g += p->g * p->a;
+                b += p->b * p->a;
+                plainR += p->r;
+                plainG += p->g;
+                plainB += p->b;
             }
-            curX -= src.Width() * lenX;
-            curY += src.Height();
         }
 
-        dest.SetClipRect(oldClipRect);
+        const u64 count = u64(sx.last - sx.first) * (sy.last - sy.first);
+        if (!a) {
+            return RGBA(u8((plainR + count / 2) / count), u8((plainG + count / 2) / count), u8((plainB + count / 2) / count), 0);
+        }
+        return RGBA(u8((r + a / 2) / a), u8((g + a / 2) / a), u8((b + a / 2) / a), u8((a + count / 2) / count));
+    }
+
+    template <typename Blender>
+    struct FilteredScaleBlitOp {
+        FilteredScaleBlitOp(const Canvas& s, Canvas& d, const Rect& a, Filter f, const std::vector<Span>& c, const std::vector<Span>& r, const Blender& b)
+            : src(s), dest(d), area(a), filter(f), columns(c), rows(r), blend(b)
+        {}
+
+        void operator()(const Rect& band) const {
+            for (int y = band.top; y < band.bottom; y++) {
+                const Span& sy = rows[y - area.top];
+                const RGBA* row0 = src.GetPixels() + sy.first * src.Width();
+                const RGBA* row1 = src.GetPixels() + sy.last * src.Width();
+                RGBA* destPixel = dest.GetPixels() + y * dest.Width() + area.left;
+
+                for (int x = 0; x < area.Width(); x++, destPixel++) {
+                    const RGBA colour = filter == boxFilter
+                        ? BoxSample(src, columns[x], sy)
+                        : BilinearSample(row0, row1, columns[x], sy.weight);
+                    *destPixel = blend(colour, *destPixel);
+                }
+            }
+        }
+
+        const Canvas& src;
+        Canvas& dest;
+        const Rect area;
+        const Filter filter;
+        const std::vector<Span>& columns;
+        const std::vector<Span>& rows;
+        const Blender& blend;
+    };
+
+    /// Renders an image on another image, stretching it with the filter given.  Mirroring (a negative w or h) only works with nearestFilter.
+    template <typename Blender>
+    static void ScaleBlit(const Canvas& src, Canvas& dest, int cx, int cy, int w, int h, Filter filter, const Blender& blend) {
+        if (filter == nearestFilter) {
+            ScaleBlit(src, dest, cx, cy, w, h, blend);
+            return;
+        }
+
+        const Rect& clip = dest.GetClipRect();
+        const Rect& srcclip = src.GetClipRect();
+        const Rect area(
+            max(clip.left, cx), max(clip.top, cy),
+            min(clip.right, cx + w), min(clip.bottom, cy + h));
+
+        if (w < 1 || h < 1 || area.Width() < 1 || area.Height() < 1 || srcclip.Width() < 1 || srcclip.Height() < 1) {
+            return;
+        }
+
+        std::vector<Span> columns;
+        std::vector<Span> rows;
+        MakeSpans(columns, filter, srcclip.left, srcclip.Width(), w, area.left - cx, area.Width());
+        MakeSpans(rows, filter, srcclip.top, srcclip.Height(), h, area.top - cy, area.Height());
+
+        const FilteredScaleBlitOp<Blender> op(src, dest, area, filter, columns, rows, blend);
+        if (&src == &dest) {
+            op(area);
+        } else {
+            ForEachBand(area, op);
+        }
+    }
+
+    template <typename Blender>
+    struct TileBlitOp {
+        TileBlitOp(const Canvas& s, Canvas& d, int _x, int _y, int _w, int _h, const Blender& b)
+            : src(s), dest(d), startX(_x), startY(_y), w(_w), h(_h), blend(b)
+        {}
+
+        void operator()(const Rect& band) const {
+            int curX = startX;
+            int curY = startY;
+            int lenX = w % src.Width();
+            int lenY = h % src.Height();
+
+            for (int y = 0; y < lenY; y++) {
+                for (int x = 0; x < lenX; x++) {
+                    Blit(src, dest, curX, curY, blend, band);
+                    curX += src.Width();
+                }
+                curX -= src.Width() * lenX;
+                curY += src.Height();
+            }
+        }
+
+        const Canvas& src;
+        Canvas& dest;
+        const int startX, startY, w, h;
+        const Blender& blend;
+    };
+
+    template <typename Blender>
+    static void TileBlit(const Canvas& src, Canvas& dest, int startX, int startY, int w, int h, int offsetX, int offsetY, const Blender& blend) {
+        // Same as setting dest's clip rect for the duration, but without changing dest under other threads.
+        const Rect area(max(0, startX), max(0, startY), min(dest.Width(), startX + w), min(dest.Height(), startY + h));
+        const TileBlitOp<Blender> op(src, dest, startX % src.Width() + offsetX, startY % src.Height() + offsetY, w, h, blend);
+
+        if (&src == &dest) {
+            op(area);
+        } else {
+            ForEachBand(area, op);
+        }
     }
 
     // ------------------------------------ Primitives ------------------------------------
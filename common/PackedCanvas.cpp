@@ -0,0 +1,200 @@
+#include "PackedCanvas.h"
+#include "memstats.h"
+
+Palette::Palette()
+    : _count(0)
+{}
+
+Palette::Palette(u8* vgaPalette)
+    : _count(256)
+{
+    for (int i = 255; i >= 0; i--) {
+        colours[i] = RGBA(u8(i), vgaPalette);
+        _indices[colours[i]] = i;
+    }
+}
+
+bool Palette::Add(const Canvas& image) {
+    const RGBA* p = image.GetPixels();
+    const RGBA* end = p + image.Width() * image.Height();
+
+    for (; p < end; p++) {
+        if (_indices.count(*p)) {
+            continue;
+        }
+        if (_count == 256) {
+            return false;
+        }
+        _indices[*p] = _count;
+        colours[_count++] = *p;
+    }
+
+    return true;
+}
+
+int Palette::Find(RGBA colour) const {
+    std::map<u32, int>::const_iterator iter = _indices.find(colour);
+    return iter != _indices.end() ? iter->second : -1;
+}
+
+PackedCanvas::PackedCanvas(u8* data, int width, int height, Palette* palette)
+    : _format(indexed)
+    , _width(width)
+    , _height(height)
+    , _data(data, data + width * height)
+    , _palette(palette)
+{
+    MemStats::Allocate(MemStats::canvas, Size());
+}
+
+PackedCanvas::PackedCanvas(u16* data, int width, int height)
+    : _format(rgb16)
+    , _width(width)
+    , _height(height)
+    , _data((u8*)data, (u8*)(data + width * height))
+{
+    MemStats::Allocate(MemStats::canvas, Size());
+}
+
+PackedCanvas::PackedCanvas(const Canvas& src, Palette* palette)
+    : _format(raw)
+    , _width(src.Width())
+    , _height(src.Height())
+{
+    if (!PackIndexed(src, palette) && !Pack16(src)) {
+        PackRLE(src);
+
+        const uint rawSize = _width * _height * sizeof(RGBA);
+        if (Size() >= rawSize) {
+            _format = raw;
+            _runs.clear();
+            _rowStart.clear();
+            const u8* pixels = (const u8*)src.GetPixels();
+            _data.assign(pixels, pixels + rawSize);
+        }
+    }
+
+    MemStats::Allocate(MemStats::canvas, Size());
+}
+
+PackedCanvas::PackedCanvas(const PackedCanvas& src)
+    : _format(src._format)
+    , _width(src._width)
+    , _height(src._height)
+    , _data(src._data)
+    , _palette(src._palette)
+    , _runs(src._runs)
+    , _rowStart(src._rowStart)
+{
+    MemStats::Allocate(MemStats::canvas, Size());
+}
+
+PackedCanvas& PackedCanvas::operator = (const PackedCanvas& rhs) {
+    if (this != &rhs) {
+        MemStats::Free(MemStats::canvas, Size());
+
+        _format = rhs._format;
+        _width = rhs._width;
+        _height = rhs._height;
+        _data = rhs._data;
+        _palette = rhs._palette;
+        _runs = rhs._runs;
+        _rowStart = rhs._rowStart;
+
+        MemStats::Allocate(MemStats::canvas, Size());
+    }
+    return *this;
+}
+
+PackedCanvas::~PackedCanvas() {
+    MemStats::Free(MemStats::canvas, Size());
+}
+
+uint PackedCanvas::Size() const {
+    return _data.size() + _runs.size() * sizeof(Run) + _rowStart.size() * sizeof(uint);
+}
+
+void PackedCanvas::Unpack(Canvas& dest) const {
+    dest.Resize(max(1, _width), max(1, _height));
+    dest.SetClipRect(Rect(0, 0, dest.Width(), dest.Height()));
+    dest.Clear(RGBA(0, 0, 0, 0));
+    Blitter::Blit(*this, dest, 0, 0, Blitter::OpaqueBlend());
+}
+
+bool PackedCanvas::PackIndexed(const Canvas& src, Palette* palette) {
+    if (!palette) {
+        return false;
+    }
+
+    const int count = _width * _height;
+    const RGBA* pixels = src.GetPixels();
+    std::vector<u8> data(count);
+
+    for (int i = 0; i < count; i++) {
+        int index = palette->Find(pixels[i]);
+        if (index == -1) {
+            return false;
+        }
+        data[i] = u8(index);
+    }
+
+    _format = indexed;
+    _data.swap(data);
+    _palette = palette;
+    return true;
+}
+
+bool PackedCanvas::Pack16(const Canvas& src) {
+    const int count = _width * _height;
+    if (count == 0) {
+        return false;
+    }
+
+    const RGBA* pixels = src.GetPixels();
+    std::vector<u8> data(count * sizeof(u16));
+    u16* dest = (u16*)&data[0];
+
+    for (int i = 0; i < count; i++) {
+        RGBA c = pixels[i];
+        u16 packed = 0;
+
+        if (c.a == 255) {
+            packed = ((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3);
+            if (!packed || Unpack16(packed) != c) {
+                return false;       // Can't be stored exactly.
+            }
+        } else if (c.a != 0) {
+            return false;           // No room for translucency.
+        }
+
+        dest[i] = packed;
+    }
+
+    _format = rgb16;
+    _data.swap(data);
+    return true;
+}
+
+void PackedCanvas::PackRLE(const Canvas& src) {
+    _format = rle;
+    _rowStart.resize(_height);
+
+    const RGBA* pixels = src.GetPixels();
+
+    for (int y = 0; y < _height; y++) {
+        _rowStart[y] = _runs.size();
+
+        const RGBA* p = pixels + y * _width;
+        const RGBA* end = p + _width;
+        while (p < end) {
+            Run run;
+            run.colour = *p;
+            run.length = 0;
+            while (p < end && *p == run.colour) {
+                run.length++;
+                p++;
+            }
+            _runs.push_back(run);
+        }
+    }
+}
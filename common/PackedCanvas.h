@@ -0,0 +1,168 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Canvas.h"
+#include "refcount.h"
+
+/// Up to 256 colours, shared by every image packed against it.
+struct Palette : RefCounted {
+    RGBA colours[256];
+
+    Palette();
+    Palette(u8* vgaPalette);                                ///< 768 bytes of 6 bit colour, as VERGE uses.  Index 0 is transparent.
+
+    bool Add(const Canvas& image);                          ///< Adds every colour the image uses.  Returns false if they don't all fit.
+    int Find(RGBA colour) const;                            ///< Returns the index of the colour, or -1.
+
+private:
+    uint _count;                                            ///< number of colours used
+    std::map<u32, int> _indices;                            ///< colour -> index
+};
+
+/**
+ *  A read only image that takes less room than a Canvas, for art that has to
+ *  stay in memory but is never edited.  Blitter::Blit draws these directly,
+ *  without unpacking them first.
+ *
+ *  raw:     plain RGBA, for images nothing else suits.
+ *  indexed: a byte per pixel, plus a palette shared with other images.  A quarter the size.
+ *  rgb16:   5-6-5 colour, where 0 means transparent.  Half the size.  (Transparent
+ *           pixels all come back black, which doesn't matter for drawing.)
+ *  rle:     runs of identical pixels.  Good for flat colour and big transparent areas.
+ */
+struct PackedCanvas {
+    enum Format { raw, indexed, rgb16, rle };
+
+    struct Run {
+        RGBA colour;
+        uint length;
+    };
+
+    PackedCanvas(u8* data, int width, int height, Palette* palette);    ///< indexed
+    PackedCanvas(u16* data, int width, int height);                     ///< rgb16
+
+    /// Packs a canvas in the smallest format that doesn't visibly lose anything.
+    /// If a palette is given, and has every colour the canvas uses, the result is indexed.
+    PackedCanvas(const Canvas& src, Palette* palette = 0);
+
+    PackedCanvas(const PackedCanvas& src);
+    PackedCanvas& operator = (const PackedCanvas& rhs);
+    ~PackedCanvas();
+
+    inline Format GetFormat() const { return _format; }
+    inline int Width() const        { return _width; }
+    inline int Height() const       { return _height; }
+    uint Size() const;                                      ///< Bytes of pixel data.  A shared palette isn't counted.
+
+    void Unpack(Canvas& dest) const;                        ///< Resizes dest and copies the image into it.
+
+    static inline RGBA Unpack16(u16 c) {
+        if (!c) {
+            return RGBA(0, 0, 0, 0);
+        }
+        u8 r = (c >> 11) & 31;
+        u8 g = (c >> 5) & 63;
+        u8 b = c & 31;
+        return RGBA((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    }
+
+    // Raw storage, for the blitters.
+    inline const RGBA* Pixels() const   { return (const RGBA*)&_data[0]; }     ///< raw
+    inline const u8* Indices() const    { return &_data[0]; }                   ///< indexed
+    inline const RGBA* Colours() const  { return _palette->colours; }           ///< indexed
+    inline const u16* Pixels16() const  { return (const u16*)&_data[0]; }      ///< rgb16
+    inline const Run* Row(int y) const  { return &_runs[_rowStart[y]]; }        ///< rle.  The runs in a row add up to its width.
+
+private:
+    bool PackIndexed(const Canvas& src, Palette* palette);
+    bool Pack16(const Canvas& src);
+    void PackRLE(const Canvas& src);
+
+    Format _format;
+    int _width, _height;
+
+    std::vector<u8> _data;                                  ///< raw, indexed and rgb16 pixels
+    RefPtr<Palette> _palette;                               ///< indexed
+    std::vector<Run> _runs;                                 ///< rle
+    std::vector<uint> _rowStart;                            ///< rle: index of the first run in each row
+};
+
+namespace Blitter {
+    /// Renders a packed image on a canvas.
+    template <typename Blender>
+    void Blit(const PackedCanvas& src, Canvas& dest, int x, int y, const Blender& blend) {
+        int xstart = 0;
+        int ystart = 0;
+        int xlen = src.Width();
+        int ylen = src.Height();
+
+        DoClipping(x, y, xstart, xlen, ystart, ylen, dest.GetClipRect());
+        if (xlen < 1 || ylen < 1) {
+            return;
+        }
+
+        RGBA* destRow = dest.GetPixels() + (y * dest.Width()) + x;
+
+        for (int row = ystart; row < ystart + ylen; row++, destRow += dest.Width()) {
+            RGBA* destPixel = destRow;
+            const int offset = row * src.Width() + xstart;
+
+            switch (src.GetFormat()) {
+                case PackedCanvas::raw: {
+                    const RGBA* p = src.Pixels() + offset;
+                    for (int i = 0; i < xlen; i++, destPixel++) {
+                        *destPixel = blend(*p++, *destPixel);
+                    }
+                    break;
+                }
+
+                case PackedCanvas::indexed: {
+                    const u8* p = src.Indices() + offset;
+                    const RGBA* colours = src.Colours();
+                    for (int i = 0; i < xlen; i++, destPixel++) {
+                        *destPixel = blend(colours[*p++], *destPixel);
+                    }
+                    break;
+                }
+
+                case PackedCanvas::rgb16: {
+                    const u16* p = src.Pixels16() + offset;
+                    for (int i = 0; i < xlen; i++, destPixel++) {
+                        *destPixel = blend(PackedCanvas::Unpack16(*p++), *destPixel);
+                    }
+                    break;
+                }
+
+                case PackedCanvas::rle: {
+                    const PackedCanvas::Run* run = src.Row(row);
+                    int skip = xstart;
+                    while (skip >= int(run->length)) {
+                        skip -= run->length;
+                        run++;
+                    }
+
+                    int left = xlen;
+                    int count = run->length - skip;
+                    for (;;) {
+                        const RGBA colour = run->colour;
+                        count = min(count, left);
+                        left -= count;
+                        while (count--) {
+                            *destPixel = blend(colour, *destPixel);
+                            destPixel++;
+                        }
+
+                        if (!left) {
+                            break;
+                        }
+                        run++;
+                        count = run->length;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
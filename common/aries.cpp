@@ -7,6 +7,7 @@
 #include <stdexcept>
 
 #include "aries.h"
+#include "memstats.h"
 
 // New as of 0.60: quoted strings behave like C string literals.
 // (except using single quotes instead of double)
@@ -165,9 +166,17 @@ namespace aries {
 
     //-------------------------------------------------------------------------
 
+    // Node sizes are counted roughly: the object plus its string.
+
     StringNode::StringNode(const std::string& str)
         : _str(str)
-    {}
+    {
+        MemStats::Allocate(MemStats::aries, sizeof(StringNode) + _str.size());
+    }
+
+    StringNode::~StringNode() {
+        MemStats::Free(MemStats::aries, sizeof(StringNode) + _str.size());
+    }
 
     bool StringNode::isString() const {
         return true;
@@ -200,9 +209,12 @@ namespace aries {
 
     DataNode::DataNode(const std::string& name)
         : _name(name)
-    {}
+    {
+        MemStats::Allocate(MemStats::aries, sizeof(DataNode) + _name.size());
+    }
 
     DataNode::~DataNode() {
+        MemStats::Free(MemStats::aries, sizeof(DataNode) + _name.size());
         for (unsigned int i = 0; i < _children.size(); i++) {
             delete _children[i];
         }
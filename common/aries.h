@@ -127,6 +127,7 @@ namespace aries {
 
     struct StringNode : Node {
         StringNode(const std::string& str);
+        virtual ~StringNode();
         virtual bool isString() const;
         virtual std::string toString() const;
         virtual StringNode* clone() const;
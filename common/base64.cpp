@@ -13,101 +13,161 @@
 
 using std::string;
 
-const char          fillchar = '=';
-
-                        // 00000000001111111111222222
-                        // 01234567890123456789012345a
-static string       cvt = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+namespace {
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    const u8 bad = 0xFF;    // not base64.  Skipped.
+    const u8 pad = 0xFE;    // '='.  The end of the data.
+
+    // Character -> 6 bit value.  Anything with either of the top two bits set isn't data.
+    const u8 decodeTable[256] = {
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,  62, bad, bad, bad,  63,
+         52,  53,  54,  55,  56,  57,  58,  59,  60,  61, bad, bad, bad, pad, bad, bad,
+        bad,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+         15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, bad, bad, bad, bad, bad,
+        bad,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+         41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+        bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad, bad,
+    };
+}
 
-                        // 22223333333333444444444455
-                        // 67890123456789012345678901
-                          "abcdefghijklmnopqrstuvwxyz"
+uint base64::encodedSize(uint size)
+{
+    return (size + 2) / 3 * 4;
+}
 
-                        // 555555556666
-                        // 234567890123
-                          "0123456789+/";
+uint base64::decodedSize(uint length)
+{
+    return (length + 3) / 4 * 3;
+}
 
-string base64::encode(const string& data)
+uint base64::encode(const u8* src, uint size, char* dest)
 {
-    string::size_type  i;
-    char               c;
-    string::size_type  len = data.length();
-    string             ret;
+    char* out = dest;
+    const u8* end = src + size - size % 3;
 
-    for (i = 0; i < len; ++i)
+    for (; src < end; src += 3, out += 4)
     {
-        c = (data[i] >> 2) & 0x3f;
-        ret.append(1, cvt[c]);
-        c = (data[i] << 4) & 0x3f;
-        if (++i < len)
-            c |= (data[i] >> 4) & 0x0f;
-
-        ret.append(1, cvt[c]);
-        if (i < len)
-        {
-            c = (data[i] << 2) & 0x3f;
-            if (++i < len)
-                c |= (data[i] >> 6) & 0x03;
+        const u32 n = (src[0] << 16) | (src[1] << 8) | src[2];
+        out[0] = alphabet[n >> 18];
+        out[1] = alphabet[(n >> 12) & 0x3f];
+        out[2] = alphabet[(n >> 6) & 0x3f];
+        out[3] = alphabet[n & 0x3f];
+    }
 
-            ret.append(1, cvt[c]);
-        }
-        else
+    switch (size % 3)
+    {
+        case 1:
         {
-            ++i;
-            ret.append(1, fillchar);
+            const u32 n = src[0] << 16;
+            out[0] = alphabet[n >> 18];
+            out[1] = alphabet[(n >> 12) & 0x3f];
+            out[2] = '=';
+            out[3] = '=';
+            out += 4;
+            break;
         }
 
-        if (i < len)
-        {
-            c = data[i] & 0x3f;
-            ret.append(1, cvt[c]);
-        }
-        else
+        case 2:
         {
-            ret.append(1, fillchar);
+            const u32 n = (src[0] << 16) | (src[1] << 8);
+            out[0] = alphabet[n >> 18];
+            out[1] = alphabet[(n >> 12) & 0x3f];
+            out[2] = alphabet[(n >> 6) & 0x3f];
+            out[3] = '=';
+            out += 4;
+            break;
         }
     }
 
-    return(ret);
+    return out - dest;
 }
 
-string base64::decode(const string& data)
+uint base64::decode(const char* src, uint length, u8* dest)
 {
-    string::size_type  i;
-    char               c;
-    char               c1;
-    string::size_type  len = data.length();
-    string             ret;
+    const u8* p = reinterpret_cast<const u8*>(src);
+    const u8* end = p + length;
+    u8* out = dest;
 
-    for (i = 0; i < len; ++i)
+    u32 bits = 0;
+    int count = 0;      // number of characters in bits
+
+    while (p < end)
     {
-        c = (char) cvt.find(data[i]);
-        ++i;
-        c1 = (char) cvt.find(data[i]);
-        c = (c << 2) | ((c1 >> 4) & 0x3);
-        ret.append(1, c);
-        if (++i < len)
+        // Whole groups of four go straight through.  Anything else
+        // (line breaks, padding, the last few characters) goes one character at a time.
+        if (count == 0 && end - p >= 4)
         {
-            c = data[i];
-            if (fillchar == c)
-                break;
-
-            c = (char) cvt.find(c);
-            c1 = ((c1 << 4) & 0xf0) | ((c >> 2) & 0xf);
-            ret.append(1, c1);
+            const u32 a = decodeTable[p[0]];
+            const u32 b = decodeTable[p[1]];
+            const u32 c = decodeTable[p[2]];
+            const u32 d = decodeTable[p[3]];
+
+            if (((a | b | c | d) & 0xc0) == 0)
+            {
+                const u32 n = (a << 18) | (b << 12) | (c << 6) | d;
+                out[0] = u8(n >> 16);
+                out[1] = u8(n >> 8);
+                out[2] = u8(n);
+                out += 3;
+                p += 4;
+                continue;
+            }
         }
 
-        if (++i < len)
-        {
-            c1 = data[i];
-            if (fillchar == c1)
-                break;
+        const u8 v = decodeTable[*p++];
+        if (v == pad)
+            break;
+        if (v == bad)
+            continue;
 
-            c1 = (char) cvt.find(c1);
-            c = ((c << 6) & 0xc0) | c1;
-            ret.append(1, c);
+        bits = (bits << 6) | v;
+        if (++count == 4)
+        {
+            out[0] = u8(bits >> 16);
+            out[1] = u8(bits >> 8);
+            out[2] = u8(bits);
+            out += 3;
+            bits = 0;
+            count = 0;
         }
     }
 
-    return(ret);
+    // Leftovers.  Two characters make one byte, three make two.
+    if (count == 2)
+    {
+        *out++ = u8(bits >> 4);
+    }
+    else if (count == 3)
+    {
+        *out++ = u8(bits >> 10);
+        *out++ = u8(bits >> 2);
+    }
+
+    return out - dest;
+}
+
+string base64::encode(const string& data)
+{
+    string ret(encodedSize(data.length()), '\0');
+    if (!data.empty())
+        encode(reinterpret_cast<const u8*>(data.data()), data.length(), &ret[0]);
+    return ret;
+}
+
+string base64::decode(const string& data)
+{
+    string ret(decodedSize(data.length()), '\0');
+    if (!data.empty())
+        ret.resize(decode(data.data(), data.length(), reinterpret_cast<u8*>(&ret[0])));
+    return ret;
 }
@@ -12,11 +12,20 @@
 #pragma once
 
 #include <string>
+#include "utility.h"
 
 class base64
 {
 public:
     static std::string encode(const std::string& data);
     static std::string decode(const std::string& data);
-};
 
+    /// The buffer versions.  These don't allocate anything, so map and sprite
+    /// loading can decode straight into the buffer zlib reads from.
+
+    static uint encodedSize(uint size);                         ///< Exactly how many characters encode writes for size bytes
+    static uint decodedSize(uint length);                       ///< The most bytes decode can write for length characters
+
+    static uint encode(const u8* src, uint size, char* dest);   ///< Returns the number of characters written.  Doesn't null terminate.
+    static uint decode(const char* src, uint length, u8* dest); ///< Returns the number of bytes written.  Skips whitespace; stops at padding.
+};
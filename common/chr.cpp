@@ -261,30 +261,26 @@ void CCHRfile::Load(const std::string& filename) {
             _hotspotHeight = std::atoi(hsNode->getChild("height")->getString().c_str());
 
             DataNode* dataNode = frameNode->getChild("data");
-            if (dataNode->getChild("format")->getString() != "zlib") {
-                throw std::runtime_error("Unsupported data format");
-            }
+            const std::string format = dataNode->getChild("format")->getString();
 
             std::string d64 = dataNode->getString();
-            ScopedArray<u8> compressed(new u8[d64.length()]); // way more than enough.
+            ScopedArray<u8> compressed(new u8[base64::decodedSize(d64.length())]);
             uint compressedSize;
             if (ver == "1.0") {
-                compressedSize = oldBase64::decode(d64, compressed.get(), d64.length());
+                compressedSize = oldBase64::decode(d64, compressed.get(), base64::decodedSize(d64.length()));
             } else {
-                std::string un64 = base64::decode(d64);
-                std::copy((u8*)(un64.c_str()), (u8*)(un64.c_str() + un64.length()), compressed.get());
-                compressedSize = un64.length();
+                compressedSize = base64::decode(d64.data(), d64.length(), compressed.get());
             }
 
-            ScopedArray<u8> pixels(new u8[_width * _height * frameCount * sizeof(RGBA)]);
-            Compression::decompress(compressed.get(), compressedSize, pixels.get(), _width * _height * frameCount * sizeof(RGBA));
+            // Inflate straight into one slab, and make the frames views of it.
+            const uint frameSize = _width * _height;
+            RefPtr<PixelSlab> slab = new PixelSlab(frameSize * frameCount);
+            Compression::unpack(format, compressed.get(), compressedSize, reinterpret_cast<u8*>(slab->pixels), frameSize * frameCount * sizeof(RGBA));
 
             ClearFrames();
             _frame.reserve(frameCount);
-            RGBA* ptr = (RGBA*)pixels.get();
             for (uint i = 0; i < frameCount; i++) {
-                _frame.push_back(new Canvas(ptr, _width, _height));
-                ptr += _width * _height;
+                _frame.push_back(new Canvas(slab.get(), i * frameSize, _width, _height));
             }
         }
 
@@ -358,11 +354,7 @@ void CCHRfile::Save(const std::string& filename) {
                 );
 
         const uint uncompressedBlockSize = _width * _height * _frame.size() * sizeof(RGBA);
-        // More than is needed.  Way more.
-        const uint compressedBlockSize = uncompressedBlockSize * 4 / 3;
-
         ScopedArray<u8> uncompressed(new u8[uncompressedBlockSize]);
-        ScopedArray<u8> compressed(new u8[compressedBlockSize]);
 
         // Pack the uncompressed data into one big block.
         RGBA* dest = reinterpret_cast<RGBA*>(uncompressed.get());
@@ -374,16 +366,15 @@ void CCHRfile::Save(const std::string& filename) {
         }
 
         // Compress.
-        uint compressSize = Compression::compress(uncompressed.get(), uncompressedBlockSize,
-                                                  compressed.get(), compressedBlockSize);
+        std::vector<u8> compressed;
+        std::string format = Compression::pack(uncompressed.get(), uncompressedBlockSize, compressed);
 
         // base64
-        //std::string d64 = base64::encode(compressed.get(), compressSize);
-        std::string d64 = base64::encode(std::string(compressed.get(),
-                                                     compressed.get() + compressSize));
+        std::string d64(base64::encodedSize(compressed.size()), '\0');
+        base64::encode(&compressed[0], compressed.size(), &d64[0]);
 
         frameNode->addChild(newNode("data")
-            ->addChild(newNode("format")->addChild("zlib"))
+            ->addChild(newNode("format")->addChild(format))
             ->addChild(d64));            
     }
 
@@ -1,9 +1,95 @@
+#include <stdexcept>
 #include <zlib.h>
 #include "compression.h"
+#include "thread.h"
+
+namespace
+{
+    const uint blockSize = 256 * 1024;
+    const uint blockThreshold = 4 * blockSize;              // pack only splits buffers bigger than this
+    const uint headerSize = 3 * sizeof(u32);
+
+    void writeU32(u8* dest, u32 value)
+    {
+        dest[0] = u8(value);
+        dest[1] = u8(value >> 8);
+        dest[2] = u8(value >> 16);
+        dest[3] = u8(value >> 24);
+    }
+
+    u32 readU32(const u8* src)
+    {
+        return src[0] | (src[1] << 8) | (src[2] << 16) | (src[3] << 24);
+    }
+
+    struct CompressTask : Parallel::Task
+    {
+        const u8* src;
+        uint srclen;
+        Compression::Level level;
+        std::vector<std::vector<u8> > blocks;
+        std::vector<u8> failed;                             // not vector<bool>: workers write neighbouring flags at once
+
+        CompressTask(const u8* s, uint len, uint count, Compression::Level l)
+            : src(s)
+            , srclen(len)
+            , level(l)
+            , blocks(count)
+            , failed(count, 0)
+        {}
+
+        virtual void Run(uint index)
+        {
+            const uint start = index * blockSize;
+            const uint len = min(blockSize, srclen - start);
+
+            std::vector<u8>& block = blocks[index];
+            block.resize(Compression::compressBound(len));
+            int size = Compression::compress(src + start, len, &block[0], block.size(), level);
+            block.resize(size);
+            failed[index] = size == 0;
+        }
+    };
+
+    struct DecompressTask : Parallel::Task
+    {
+        std::vector<const u8*> blocks;
+        std::vector<uint> sizes;
+        u8* dest;
+        uint destlen;
+        std::vector<u8> failed;                             // one byte each, as in CompressTask
+
+        DecompressTask(u8* d, uint len, uint count)
+            : blocks(count)
+            , sizes(count)
+            , dest(d)
+            , destlen(len)
+            , failed(count, 0)
+        {}
+
+        virtual void Run(uint index)
+        {
+            const uint start = index * blockSize;
+            const uint len = min(blockSize, destlen - start);
+
+            failed[index] = !Compression::decompress(blocks[index], sizes[index], dest + start, len);
+        }
+    };
+}
 
 namespace Compression
 {
-    int compress(const u8* src, int srclen, u8* dest, int destlen)
+    const char* const zlibFormat = "zlib";
+    const char* const blockFormat = "zlib-blocks";
+
+    uint compressBound(uint srclen)
+    {
+        // zlib's own compressBound is too new for the zlib we ship.  Incompressible data
+        // grows by a few bytes per 16K block, plus the header; this is comfortably more.
+        return srclen + (srclen >> 8) + 64;
+    }
+
+    int compress(const u8* src, int srclen, u8* dest, int destlen, Level level)
     {
         z_stream stream;
 
@@ -15,16 +101,19 @@ namespace Compression
 
         stream.zalloc = NULL;
         stream.zfree = NULL;
+        stream.opaque = NULL;
+
+        if (deflateInit(&stream, level) != Z_OK)
+            return 0;
 
-        deflateInit(&stream, Z_DEFAULT_COMPRESSION);
-        deflate(&stream, Z_SYNC_FLUSH);
+        // Finishing the stream fails if dest is too small, instead of quietly cutting it off.
+        int result = deflate(&stream, Z_FINISH);
         deflateEnd(&stream);
 
-        return stream.total_out;
-        // TODO: error returns
+        return result == Z_STREAM_END ? stream.total_out : 0;
     }
 
-    void decompress(const u8* src, int srclen, u8* dest, int destlen)
+    bool decompress(const u8* src, int srclen, u8* dest, int destlen)
     {
         z_stream stream;
 
@@ -36,11 +125,114 @@ namespace Compression
 
         stream.zalloc = NULL;
         stream.zfree = NULL;
+        stream.opaque = NULL;
+
+        if (inflateInit(&stream) != Z_OK)
+            return false;
 
-        inflateInit(&stream);
-        inflate(&stream, Z_SYNC_FLUSH);
+        // Older files were never finished, only flushed, so Z_OK is fine as long as everything came out.
+        int result = inflate(&stream, Z_SYNC_FLUSH);
         inflateEnd(&stream);
 
-        // TODO: error returns
+        return (result == Z_STREAM_END || result == Z_OK) && stream.avail_out == 0;
+    }
+
+    void compressBlocks(const u8* src, uint srclen, std::vector<u8>& dest, Level level)
+    {
+        const uint count = (srclen + blockSize - 1) / blockSize;
+
+        CompressTask task(src, srclen, count, level);
+        Parallel::For(task, count);
+
+        uint total = headerSize + count * sizeof(u32);
+        for (uint i = 0; i < count; i++)
+        {
+            if (task.failed[i])
+                throw std::runtime_error("Compression failed");
+            total += task.blocks[i].size();
+        }
+
+        dest.resize(total);
+        writeU32(&dest[0], blockSize);
+        writeU32(&dest[4], srclen);
+        writeU32(&dest[8], count);
+
+        u8* p = &dest[0] + headerSize + count * sizeof(u32);
+        for (uint i = 0; i < count; i++)
+        {
+            const std::vector<u8>& block = task.blocks[i];
+            writeU32(&dest[headerSize + i * sizeof(u32)], block.size());
+            std::copy(block.begin(), block.end(), p);
+            p += block.size();
+        }
+    }
+
+    void decompressBlocks(const u8* src, uint srclen, u8* dest, uint destlen)
+    {
+        if (srclen < headerSize)
+            throw std::runtime_error("Compressed data is truncated");
+
+        const uint size = readU32(src);
+        const uint total = readU32(src + 4);
+        const uint count = readU32(src + 8);
+
+        if (size != blockSize || total != destlen || count != (total + blockSize - 1) / blockSize)
+            throw std::runtime_error(va("Compressed data has the wrong size.  Expected %u bytes, got %u", destlen, total));
+        if (srclen - headerSize < count * sizeof(u32))
+            throw std::runtime_error("Compressed data is truncated");
+
+        DecompressTask task(dest, destlen, count);
+
+        const u8* p = src + headerSize + count * sizeof(u32);
+        const u8* end = src + srclen;
+        for (uint i = 0; i < count; i++)
+        {
+            const uint len = readU32(src + headerSize + i * sizeof(u32));
+            if (uint(end - p) < len)
+                throw std::runtime_error("Compressed data is truncated");
+
+            task.blocks[i] = p;
+            task.sizes[i] = len;
+            p += len;
+        }
+
+        Parallel::For(task, count);
+
+        for (uint i = 0; i < count; i++)
+        {
+            if (task.failed[i])
+                throw std::runtime_error(va("Compressed data is damaged (block %u of %u)", i + 1, count));
+        }
+    }
+
+    std::string pack(const u8* src, uint srclen, std::vector<u8>& dest, Level level)
+    {
+        if (srclen > blockThreshold)
+        {
+            compressBlocks(src, srclen, dest, level);
+            return blockFormat;
+        }
+
+        dest.resize(compressBound(srclen));
+        int size = compress(src, srclen, &dest[0], dest.size(), level);
+        if (size == 0)
+            throw std::runtime_error("Compression failed");
+        dest.resize(size);
+        return zlibFormat;
+    }
+
+    void unpack(const std::string& format, const u8* src, uint srclen, u8* dest, uint destlen)
+    {
+        if (format == zlibFormat)
+        {
+            if (!decompress(src, srclen, dest, destlen))
+                throw std::runtime_error("Compressed data is damaged");
+        }
+        else if (format == blockFormat)
+        {
+            decompressBlocks(src, srclen, dest, destlen);
+        }
+        else
+            throw std::runtime_error(va("Unrecognized data format %s", format.c_str()));
     }
 }
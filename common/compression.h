@@ -1,10 +1,43 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "utility.h"
 
 namespace Compression
 {
-    int compress(const u8* src, int srclen, u8* dest, int destlen); // returns the amount of space used to compress; 0 on error
-    void decompress(const u8* src, int srclen, u8* dest, int destlen);
-}
+    /// zlib compression levels.  fast is several times quicker than normal, and the files come out a little bigger.
+    enum Level
+    {
+        fast = 1,
+        normal = 6,
+        best = 9
+    };
+
+    uint compressBound(uint srclen);                                                    // the most space compress can need
+    int compress(const u8* src, int srclen, u8* dest, int destlen, Level level = normal); // returns the amount of space used to compress; 0 on error
+    bool decompress(const u8* src, int srclen, u8* dest, int destlen);                   // false unless exactly destlen bytes come out
+
+    /**
+     *  Big buffers are split into independently compressed blocks, which are
+     *  compressed and decompressed in parallel.  The container is a header
+     *  (block size, total size, block count, each block's compressed size, all
+     *  little endian u32s) followed by the blocks, each a complete zlib stream.
+     *
+     *  Both throw std::runtime_error if something goes wrong.
+     */
+    void compressBlocks(const u8* src, uint srclen, std::vector<u8>& dest, Level level = normal);
+    void decompressBlocks(const u8* src, uint srclen, u8* dest, uint destlen);
 
+    extern const char* const zlibFormat;                    ///< "zlib": a single stream
+    extern const char* const blockFormat;                   ///< "zlib-blocks": compressBlocks
+
+    /// Compresses data for a file, and returns the name of the format used.  Anything smaller than
+    /// a few blocks becomes a single zlib stream, which every version of ika can read.
+    std::string pack(const u8* src, uint srclen, std::vector<u8>& dest, Level level = normal);
+
+    /// Decompresses something pack made.  Throws std::runtime_error if the format is unknown, the
+    /// data is damaged, or it doesn't come to exactly destlen bytes.
+    void unpack(const std::string& format, const u8* src, uint srclen, u8* dest, uint destlen);
+}
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "utility.h"
+#include "trace.h"
 
 //#define LOG_CALLBACK
 
@@ -32,5 +33,5 @@ namespace Log {
 #   define CDEBUG(x) CCallbackLog __callbacklogger(x)
 
 #else
-#   define CDEBUG(x)
+#   define CDEBUG(x) Trace::Scope __tracescope(x)
 #endif
@@ -199,11 +199,10 @@ bool Map::Load(const std::string& filename) {
 
                 {
                     DataNode* dataNode = (*iter)->getChild("data");
-                    if (Local::getStringNode(dataNode, "format") != "zlib")
-                        throw std::runtime_error("Unrecognized data format.");
+                    const std::string format = Local::getStringNode(dataNode, "format");
 
                     std::string d64 = dataNode->getString();
-                    ScopedArray<u8> compressed(new u8[d64.length()]);
+                    ScopedArray<u8> compressed(new u8[base64::decodedSize(d64.length())]);
                     size_t compressedSize = 0;
                         
                     if (ver == "1.0") {
@@ -217,39 +216,36 @@ bool Map::Load(const std::string& filename) {
                             warn1dot0 = true;
                         }
 
-                        compressedSize = oldBase64::decode(d64, compressed.get(), d64.length());
+                        compressedSize = oldBase64::decode(d64, compressed.get(), base64::decodedSize(d64.length()));
                     } else if (ver == "1.1" || ver == "1.2") {
-                        std::string un64 = base64::decode(d64);
-                        std::copy((u8*)un64.c_str(), (u8*)un64.c_str() + un64.length(), compressed.get());
-                        compressedSize = un64.length();
+                        compressedSize = base64::decode(d64.data(), d64.length(), compressed.get());
                     } else {
                         // Don't know how to handle
                         assert(false);
                     }
 
                     ScopedArray<uint> tiles(new uint[width * height]);
-                    Compression::decompress(compressed.get(), compressedSize, reinterpret_cast<u8*>(tiles.get()), width * height * sizeof(uint));
+                    Compression::unpack(format, compressed.get(), compressedSize, reinterpret_cast<u8*>(tiles.get()), width * height * sizeof(uint));
                     lay->tiles = Matrix<uint>(width, height, tiles.get());
                 }
  {
                     DataNode* obsNode = (*iter)->getChild("obstructions");
+                    const std::string format = Local::getStringNode(obsNode, "format");
 
                     std::string d64 = obsNode->getString();
-                    ScopedArray<u8> compressed(new u8[d64.length()]);
+                    ScopedArray<u8> compressed(new u8[base64::decodedSize(d64.length())]);
                     size_t compressedSize = 0;
 
                     if (ver == "1.0") {
-                        compressedSize = oldBase64::decode(d64, compressed.get(), d64.length());
+                        compressedSize = oldBase64::decode(d64, compressed.get(), base64::decodedSize(d64.length()));
                     } else if (ver == "1.1" || ver == "1.2") {
-                        std::string un64 = base64::decode(d64);
-                        std::copy((u8*)(un64.c_str()), (u8*)(un64.c_str() + un64.length()), compressed.get());
-                        compressedSize = un64.length();
+                        compressedSize = base64::decode(d64.data(), d64.length(), compressed.get());
                     } else {
                         assert(false);
                     }
 
                     ScopedArray<u8> obs(new u8[width * height]);
-                    Compression::decompress(compressed.get(), compressedSize, obs.get(), width * height);
+                    Compression::unpack(format, compressed.get(), compressedSize, obs.get(), width * height);
                     lay->obstructions = Matrix<u8>(width, height, obs.get());
                 }
 
@@ -319,7 +315,7 @@ bool Map::Load(const std::string& filename) {
     }
 }
 
-void Map::Save(const std::string& filename) {
+void Map::Save(const std::string& filename, Compression::Level level) {
     DataNode* rootNode = newNode("ika-map");
 
     rootNode->addChild(newNode("version")->addChild("1.2"));
@@ -429,36 +425,36 @@ void Map::Save(const std::string& filename) {
                     );
 
             {
-                const size_t dataSize = lay->Width() * lay->Height() * sizeof(uint);
-                ScopedArray<u8> compressed(new u8[dataSize]);
-                size_t compressSize = Compression::compress(
+                std::vector<u8> compressed;
+                std::string format = Compression::pack(
                        reinterpret_cast<const u8*>(lay->tiles.GetPointer(0, 0)),
-                       dataSize,
-                       compressed.get(),
-                       dataSize);
+                       lay->Width() * lay->Height() * sizeof(uint),
+                       compressed,
+                       level);
 
-                //std::string d64 = base64::encode(reinterpret_cast<u8*>(compressed.get()), compressSize);
-                std::string d64 = base64::encode(std::string(compressed.get(), compressed.get() + compressSize));
+                std::string d64(base64::encodedSize(compressed.size()), '\0');
+                base64::encode(&compressed[0], compressed.size(), &d64[0]);
 
                 layNode->addChild(newNode("data")
-                    ->addChild(newNode("format")->addChild("zlib"))
+                    ->addChild(newNode("format")->addChild(format))
                     ->addChild(d64)
                     );
             }
 
             {
-                ScopedArray<u8> compressed(new u8[lay->Width() * lay->Height() * sizeof(uint)]);
-                size_t compressSize = Compression::compress(
+                std::vector<u8> compressed;
+                std::string format = Compression::pack(
                        lay->obstructions.GetPointer(0, 0),
                        lay->Width() * lay->Height(),
-                       compressed.get(),
-                       lay->Width() * lay->Height());
+                       compressed,
+                       level);
 
-                std::string d64 = base64::encode(std::string(compressed.get(), compressed.get() + compressSize));
+                std::string d64(base64::encodedSize(compressed.size()), '\0');
+                base64::encode(&compressed[0], compressed.size(), &d64[0]);
 
                 layNode->addChild(newNode("obstructions")
                     ->addChild(newNode("style")->addChild("tile"))
-                    ->addChild(newNode("format")->addChild("zlib"))
+                    ->addChild(newNode("format")->addChild(format))
                     ->addChild(d64)
                     );
             }
@@ -4,6 +4,7 @@
 #include "utility.h"
 #include "types.h"
 #include "matrix.h"
+#include "compression.h"
 
 #include <string>
 #include <map>
@@ -149,7 +150,7 @@ public:
     // bool to make iked's template controller thing happy.  always returns
     // true.  Throws an exception if something went wrong.
     bool Load(const std::string& filename);
-    void Save(const std::string& filename);
+    void Save(const std::string& filename, Compression::Level level = Compression::normal);   // Throws std::runtime_error if compression fails.
 
     Layer* GetLayer(uint index);
     uint LayerIndex(Layer* lay) const;
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <algorithm>
 
+#include "memstats.h"
 #include "utility.h"
 
 //#define FOLLOWTHEWHITERABBIT
@@ -75,7 +76,7 @@ struct Matrix {
         , _height(h) 
     {
         if (w > 0 && h > 0) {
-            _data = new T[w * h];
+            _data = Allocate(w, h);
             std::fill(_data, _data + w * h, T());
         } else {
             _data = 0;
@@ -87,7 +88,7 @@ struct Matrix {
         , _height(h)
     {
         if (w > 0 && h > 0) {
-            _data = new T[w * h];
+            _data = Allocate(w, h);
             std::copy(d, d + w * h, _data);
         } else {
             _width = _height = 0;
@@ -104,7 +105,7 @@ struct Matrix {
         , _height(h) 
     {
         if (w > 0 && h > 0) {
-            _data = new T[w * h];
+            _data = Allocate(w, h);
             int y = h;
             T* dest = _data;
             while (y--) {
@@ -123,7 +124,7 @@ struct Matrix {
         , _height(rhs._height) 
     {
         if (rhs._data) {
-            _data = new T[_width * _height];
+            _data = Allocate(_width, _height);
             std::copy(rhs._data, rhs._data + _width * _height, _data);
         } else {
             _data = 0;
@@ -137,7 +138,7 @@ struct Matrix {
     {}
 
     ~Matrix() {
-        delete[] _data;
+        Free();
     }
 
     T& operator ()(U x, U y) {
@@ -180,15 +181,14 @@ struct Matrix {
         }
 
         if (newx == 0 || newy == 0) {
+            Free();
             _width = _height = 0;
-            delete[] _data;
-            _data = 0;
 
         } else {
             size_t sx = newx < _width  ? newx : _width;
             size_t sy = newy < _height ? newy : _height;
 
-            T* tempData = new T[newx * newy];
+            T* tempData = Allocate(newx, newy);
             std::fill(tempData, tempData + newx * newy, T());
 
             T* src = _data;
@@ -201,7 +201,7 @@ struct Matrix {
                 sy--;
             }
 
-            delete[] _data;
+            Free();
             _data = tempData;
             _width  = newx;
             _height = newy;
@@ -209,12 +209,16 @@ struct Matrix {
     }
 
     Matrix& operator = (const Matrix& rhs) {
-        delete[] _data;
+        if (this == &rhs) {
+            return *this;
+        }
+
+        Free();
         _width = rhs._width;
         _height = rhs._height;
 
         if (rhs._data) {
-            _data = new T[_width * _height];
+            _data = Allocate(_width, _height);
             std::copy(rhs._data, rhs._data + _width * _height, _data);
         } else {
             _data = 0;
@@ -224,6 +228,20 @@ struct Matrix {
     }
 
 private:
+    // Matrices are only used for maps, so that's where they get counted.
+    static T* Allocate(U w, U h) {
+        MemStats::Allocate(MemStats::map, w * h * sizeof(T));
+        return new T[w * h];
+    }
+
+    void Free() {
+        if (_data) {
+            MemStats::Free(MemStats::map, _width * _height * sizeof(T));
+            delete[] _data;
+            _data = 0;
+        }
+    }
+
     T* _data;
     U _width;
     U _height;
@@ -0,0 +1,60 @@
+#include "memstats.h"
+#include "log.h"
+#include "thread.h"
+
+namespace MemStats {
+    const char* const categoryNames[numCategories] = {
+        "canvas", "texture", "texturepadding", "map", "aries", "script"
+    };
+
+    namespace {
+        Mutex mutex;
+        size_t current[numCategories];
+        size_t highWater[numCategories];
+        size_t total;
+        size_t totalHighWater;
+    }
+
+    void Allocate(Category c, size_t bytes) {
+        ScopedLock lock(mutex);
+        current[c] += bytes;
+        total += bytes;
+        highWater[c] = max(highWater[c], current[c]);
+        totalHighWater = max(totalHighWater, total);
+    }
+
+    void Free(Category c, size_t bytes) {
+        ScopedLock lock(mutex);
+        current[c] -= min(bytes, current[c]);
+        total -= min(bytes, total);
+    }
+
+    size_t Current(Category c) {
+        ScopedLock lock(mutex);
+        return current[c];
+    }
+
+    size_t HighWater(Category c) {
+        ScopedLock lock(mutex);
+        return highWater[c];
+    }
+
+    size_t Total() {
+        ScopedLock lock(mutex);
+        return total;
+    }
+
+    size_t TotalHighWater() {
+        ScopedLock lock(mutex);
+        return totalHighWater;
+    }
+
+    void Log() {
+        ::Log::Write("Memory use (KB, current / high water):");
+        for (int i = 0; i < numCategories; i++) {
+            ::Log::Write("    %-16s %8u / %8u", categoryNames[i],
+                uint(Current(Category(i)) / 1024), uint(HighWater(Category(i)) / 1024));
+        }
+        ::Log::Write("    %-16s %8u / %8u", "total", uint(Total() / 1024), uint(TotalHighWater() / 1024));
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ *  Keeps count of how much memory the big consumers are using, and the most
+ *  they have ever used at once.
+ *
+ *  Only allocations that call Allocate and Free are counted, so these figures
+ *  are a lower bound, not what the operating system sees.
+ */
+namespace MemStats {
+    enum Category {
+        canvas,             ///< Canvas pixels
+        texture,            ///< texture memory that holds images
+        texturePadding,     ///< texture memory wasted rounding images up to powers of two
+        map,                ///< tile and obstruction matrices
+        aries,              ///< aries document trees
+        script,             ///< ika's own Python objects (not Python's data)
+        numCategories
+    };
+
+    extern const char* const categoryNames[numCategories];
+
+    void Allocate(Category c, size_t bytes);
+    void Free(Category c, size_t bytes);
+
+    size_t Current(Category c);
+    size_t HighWater(Category c);
+    size_t Total();                         ///< Sum of all categories
+    size_t TotalHighWater();                ///< Most ever in use at once, over all categories
+
+    void Log();                             ///< Writes every figure to the log.
+}
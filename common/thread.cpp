@@ -0,0 +1,327 @@
+#include "thread.h"
+
+#include <deque>
+
+#ifdef WIN32
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <pthread.h>
+#   include <unistd.h>
+#endif
+
+#ifdef WIN32
+
+Mutex::Mutex() {
+    CRITICAL_SECTION* cs = new CRITICAL_SECTION;
+    InitializeCriticalSection(cs);
+    _handle = cs;
+}
+
+Mutex::~Mutex() {
+    CRITICAL_SECTION* cs = (CRITICAL_SECTION*)_handle;
+    DeleteCriticalSection(cs);
+    delete cs;
+}
+
+void Mutex::Lock() {
+    EnterCriticalSection((CRITICAL_SECTION*)_handle);
+}
+
+void Mutex::Unlock() {
+    LeaveCriticalSection((CRITICAL_SECTION*)_handle);
+}
+
+#else
+
+Mutex::Mutex() {
+    pthread_mutex_t* m = new pthread_mutex_t;
+    pthread_mutex_init(m, 0);
+    _handle = m;
+}
+
+Mutex::~Mutex() {
+    pthread_mutex_t* m = (pthread_mutex_t*)_handle;
+    pthread_mutex_destroy(m);
+    delete m;
+}
+
+void Mutex::Lock() {
+    pthread_mutex_lock((pthread_mutex_t*)_handle);
+}
+
+void Mutex::Unlock() {
+    pthread_mutex_unlock((pthread_mutex_t*)_handle);
+}
+
+#endif
+
+namespace {
+    /// Counts wakeups, so that none are lost if Post happens before Wait.
+    /// Never destroyed, since the workers wait on them until the process ends.
+    struct Semaphore {
+        Semaphore();
+
+        void Post(uint count);
+        void Wait();
+
+    private:
+#ifdef WIN32
+        HANDLE _handle;
+#else
+        pthread_mutex_t _mutex;
+        pthread_cond_t _cond;
+        uint _count;
+#endif
+    };
+
+#ifdef WIN32
+
+    Semaphore::Semaphore() {
+        _handle = CreateSemaphore(0, 0, 0x7FFFFFFF, 0);
+    }
+
+    void Semaphore::Post(uint count) {
+        ReleaseSemaphore(_handle, count, 0);
+    }
+
+    void Semaphore::Wait() {
+        WaitForSingleObject(_handle, INFINITE);
+    }
+
+    typedef DWORD (WINAPI *ThreadMain)(void*);
+
+    void StartThread(ThreadMain main) {
+        CloseHandle(CreateThread(0, 0, main, 0, 0, 0));
+    }
+
+    uint ProcessorCount() {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwNumberOfProcessors;
+    }
+
+#else
+
+    Semaphore::Semaphore()
+        : _count(0)
+    {
+        pthread_mutex_init(&_mutex, 0);
+        pthread_cond_init(&_cond, 0);
+    }
+
+    void Semaphore::Post(uint count) {
+        pthread_mutex_lock(&_mutex);
+        _count += count;
+        pthread_cond_broadcast(&_cond);
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    void Semaphore::Wait() {
+        pthread_mutex_lock(&_mutex);
+        while (_count == 0) {
+            pthread_cond_wait(&_cond, &_mutex);
+        }
+        _count--;
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    typedef void* (*ThreadMain)(void*);
+
+    void StartThread(ThreadMain main) {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, main, 0) == 0) {
+            pthread_detach(thread);
+        }
+    }
+
+    uint ProcessorCount() {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        return count > 0 ? uint(count) : 1;
+    }
+
+#endif
+
+    // The pool.  Everything here is guarded by poolMutex.
+    Mutex poolMutex;
+    Semaphore* wake = 0;            // workers wait on this for a job
+    Semaphore* done = 0;            // For waits on this for the workers to finish
+    uint threadCount = 0;           // 0 until decided
+    uint workers = 0;               // number of worker threads started
+    bool busy = false;              // a job is running
+
+    // The current job
+    Parallel::Task* task = 0;
+    uint pieces = 0;
+    uint nextPiece = 0;              // the first piece nobody has started
+    uint helping = 0;               // workers that haven't finished with the job yet
+
+    bool NextPiece(uint& index) {
+        ScopedLock lock(poolMutex);
+        if (nextPiece >= pieces) {
+            return false;
+        }
+        index = nextPiece++;
+        return true;
+    }
+
+    void Work() {
+        uint index;
+        while (NextPiece(index)) {
+            task->Run(index);
+        }
+    }
+
+    void WorkerLoop() {
+        for (;;) {
+            wake->Wait();
+            Work();
+
+            ScopedLock lock(poolMutex);
+            if (--helping == 0) {
+                done->Post(1);
+            }
+        }
+    }
+
+    // The background thread.  Everything here is guarded by backgroundMutex.
+    Mutex backgroundMutex;
+    Semaphore* backgroundWake = 0;  // posted once per queued task
+    Semaphore* backgroundIdle = 0;  // FinishBackground waits on this
+    std::deque<Parallel::Task*> backgroundQueue;
+    uint backgroundPending = 0;     // tasks queued or running
+    uint backgroundWaiters = 0;     // threads in FinishBackground
+
+    void BackgroundLoop() {
+        for (;;) {
+            backgroundWake->Wait();
+
+            Parallel::Task* t;
+            {
+                ScopedLock lock(backgroundMutex);
+                t = backgroundQueue.front();
+                backgroundQueue.pop_front();
+            }
+
+            t->Run(0);
+            delete t;
+
+            ScopedLock lock(backgroundMutex);
+            if (--backgroundPending == 0 && backgroundWaiters) {
+                backgroundIdle->Post(backgroundWaiters);
+                backgroundWaiters = 0;
+            }
+        }
+    }
+
+#ifdef WIN32
+    DWORD WINAPI WorkerMain(void*) {
+        WorkerLoop();
+        return 0;
+    }
+
+    DWORD WINAPI BackgroundMain(void*) {
+        BackgroundLoop();
+        return 0;
+    }
+#else
+    void* WorkerMain(void*) {
+        WorkerLoop();
+        return 0;
+    }
+
+    void* BackgroundMain(void*) {
+        BackgroundLoop();
+        return 0;
+    }
+#endif
+
+    uint DecideThreadCount() {
+        if (threadCount == 0) {
+            threadCount = ProcessorCount();
+        }
+        return threadCount;
+    }
+}
+
+namespace Parallel {
+    uint ThreadCount() {
+        ScopedLock lock(poolMutex);
+        return DecideThreadCount();
+    }
+
+    void SetThreadCount(uint count) {
+        ScopedLock lock(poolMutex);
+        if (workers == 0) {
+            threadCount = count;
+        }
+    }
+
+    void For(Task& t, uint count) {
+        bool alone = true;
+
+        {
+            ScopedLock lock(poolMutex);
+            if (!busy && count > 1) {
+                if (!wake) {
+                    wake = new Semaphore;
+                    done = new Semaphore;
+                    for (uint i = 1; i < DecideThreadCount(); i++) {
+                        StartThread(WorkerMain);
+                        workers++;
+                    }
+                }
+
+                if (workers > 0) {
+                    busy = true;
+                    alone = false;
+
+                    task = &t;
+                    pieces = count;
+                    nextPiece = 0;
+                    helping = min(workers, count - 1);
+                    wake->Post(helping);
+                }
+            }
+        }
+
+        if (alone) {
+            for (uint i = 0; i < count; i++) {
+                t.Run(i);
+            }
+            return;
+        }
+
+        Work();
+        done->Wait();
+
+        ScopedLock lock(poolMutex);
+        task = 0;
+        busy = false;
+    }
+
+    void Background(Task* t) {
+        ScopedLock lock(backgroundMutex);
+        if (!backgroundWake) {
+            backgroundWake = new Semaphore;
+            backgroundIdle = new Semaphore;
+            StartThread(BackgroundMain);
+        }
+
+        backgroundQueue.push_back(t);
+        backgroundPending++;
+        backgroundWake->Post(1);
+    }
+
+    void FinishBackground() {
+        {
+            ScopedLock lock(backgroundMutex);
+            if (backgroundPending == 0) {
+                return;
+            }
+            backgroundWaiters++;
+        }
+
+        backgroundIdle->Wait();
+    }
+}
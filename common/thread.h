@@ -0,0 +1,67 @@
+#pragma once
+
+#include "utility.h"
+
+/**
+ *  Just enough threading to keep shared data safe.
+ */
+struct Mutex {
+    Mutex();
+    ~Mutex();
+
+    void Lock();
+    void Unlock();
+
+private:
+    void* _handle;      ///< platform specific
+
+    Mutex(const Mutex&);
+    Mutex& operator = (const Mutex&);
+};
+
+/// Locks a mutex for as long as it exists.
+struct ScopedLock {
+    ScopedLock(Mutex& m) : _mutex(m) { _mutex.Lock(); }
+    ~ScopedLock() { _mutex.Unlock(); }
+
+private:
+    Mutex& _mutex;
+
+    ScopedLock(const ScopedLock&);
+    ScopedLock& operator = (const ScopedLock&);
+};
+
+/// Declares a variable that each thread has its own copy of.  Only works for plain old data.
+#ifdef _MSC_VER
+#   define THREAD_LOCAL __declspec(thread)
+#else
+#   define THREAD_LOCAL __thread
+#endif
+
+/**
+ *  A pool of worker threads, for splitting big jobs into independent pieces.
+ *  The threads are started the first time they're needed, and sleep between jobs.
+ */
+namespace Parallel {
+    /// One job, in pieces.  Run is called once for each piece, from whichever thread is free.
+    /// It must not throw; record failures and check them once For returns.
+    struct Task {
+        virtual ~Task() {}
+        virtual void Run(uint index) = 0;
+    };
+
+    uint ThreadCount();                                     ///< How many threads work on a job, including the one calling For.
+    void SetThreadCount(uint count);                        ///< 0 means one per processor.  Takes effect before the first job only.
+
+    /// Runs task.Run(0) through task.Run(count - 1), spread across the pool, and returns when they have all finished.
+    /// The calling thread does its share.  If the pool is already busy (another thread's job, or For called from
+    /// inside a task) the pieces just run here, in order.
+    void For(Task& task, uint count);
+
+    /// Runs task->Run(0) on a thread of its own, for slow work (like writing files) that nothing has to wait for.
+    /// Tasks run one at a time, in the order given.  Each is deleted once it has run.
+    void Background(Task* task);
+
+    /// Returns once every background task so far has finished.  Call before exiting, so nothing is cut off.
+    void FinishBackground();
+}
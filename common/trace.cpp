@@ -0,0 +1,133 @@
+#include <set>
+#include <stdio.h>
+
+#include "trace.h"
+#include "thread.h"
+#include "utility.h"
+
+namespace Trace {
+    bool enabled = false;
+
+    namespace {
+        const uint bufferSize = 1 << 16;                    // events per thread
+
+        struct Event {
+            const char* name;                               // 0 for the end of a span
+            double time;
+        };
+
+        struct Buffer {
+            uint thread;
+            uint next;                                      // total number of events ever written
+            Event events[bufferSize];
+        };
+
+        // Buffers are never freed, since a thread may still be holding a pointer to its own.
+        Mutex mutex;
+        std::vector<Buffer*> buffers;
+        std::set<std::string> names;
+        double startTime = GetPreciseTime();
+
+        THREAD_LOCAL Buffer* threadBuffer = 0;
+
+        Buffer* GetBuffer() {
+            if (!threadBuffer) {
+                Buffer* b = new Buffer;
+                b->next = 0;
+
+                ScopedLock lock(mutex);
+                b->thread = buffers.size() + 1;
+                buffers.push_back(b);
+                threadBuffer = b;
+            }
+            return threadBuffer;
+        }
+
+        inline void Record(const char* name) {
+            Buffer* b = GetBuffer();
+            Event& e = b->events[b->next % bufferSize];
+            e.name = name;
+            e.time = GetPreciseTime();
+            b->next++;
+        }
+
+        void WriteString(FILE* f, const char* s) {
+            fputc('"', f);
+            for (; *s; s++) {
+                unsigned char c = *s;
+                if (c == '"' || c == '\\') {
+                    fputc('\\', f);
+                    fputc(c, f);
+                } else if (c < 0x20) {
+                    fprintf(f, "\\u%04x", c);
+                } else {
+                    fputc(c, f);
+                }
+            }
+            fputc('"', f);
+        }
+    }
+
+    void Enable(bool e) {
+        enabled = e;
+    }
+
+    void Begin(const char* name) {
+        if (enabled) {
+            Record(name);
+        }
+    }
+
+    void End() {
+        if (enabled) {
+            Record(0);
+        }
+    }
+
+    const char* Intern(const std::string& name) {
+        ScopedLock lock(mutex);
+        return names.insert(name).first->c_str();
+    }
+
+    bool Dump(const std::string& fileName) {
+        FILE* f = fopen(fileName.c_str(), "w");
+        if (!f) {
+            return false;
+        }
+
+        ScopedLock lock(mutex);
+
+        fprintf(f, "{\"traceEvents\":[\n");
+        bool first = true;
+
+        for (uint i = 0; i < buffers.size(); i++) {
+            const Buffer* b = buffers[i];
+
+            // Other threads may keep writing while we read.  At worst we get
+            // a few events that are newer than the ones around them.
+            uint end = b->next;
+            uint start = end > bufferSize ? end - bufferSize : 0;
+
+            for (uint j = start; j < end; j++) {
+                const Event& e = b->events[j % bufferSize];
+                double ts = (e.time - startTime) * 1000000.0;
+
+                fprintf(f, first ? "" : ",\n");
+                first = false;
+
+                if (e.name) {
+                    fprintf(f, "{\"name\":");
+                    WriteString(f, e.name);
+                    fprintf(f, ",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, b->thread);
+                } else {
+                    fprintf(f, "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, b->thread);
+                }
+            }
+        }
+
+        fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        bool ok = !ferror(f);
+        fclose(f);
+        return ok;
+    }
+}
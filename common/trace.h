@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+/**
+ *  Records when things start and stop, so that they can be looked at in
+ *  chrome://tracing or Perfetto.
+ *
+ *  Each thread writes into its own ring buffer, so recording never takes a
+ *  lock.  When a buffer fills, the oldest events are overwritten.  While
+ *  tracing is off, a Scope costs one test of a global flag.
+ *
+ *  Names are not copied.  They must be string literals, or come from Intern.
+ */
+namespace Trace {
+    extern bool enabled;                                    ///< Don't set directly.  Use Enable.
+
+    void Enable(bool e);
+    inline bool IsEnabled() { return enabled; }
+
+    void Begin(const char* name);                           ///< Does nothing unless tracing is enabled.
+    void End();                                             ///< Ditto.
+
+    const char* Intern(const std::string& name);            ///< Returns a copy of name that lives until the program ends.
+
+    /// Writes everything still in the buffers as Chrome trace event JSON.
+    /// Returns false if the file could not be written.
+    bool Dump(const std::string& fileName);
+
+    /// Records a span that lasts as long as the Scope does.
+    struct Scope {
+        Scope(const char* name)
+            : _active(enabled)
+        {
+            if (_active) {
+                Begin(name);
+            }
+        }
+
+        ~Scope() {
+            if (_active) {
+                End();
+            }
+        }
+
+    private:
+        bool _active;       ///< So turning tracing on or off inside a span doesn't unbalance it.
+    };
+}
@@ -10,7 +10,16 @@
 #include <sstream>
 #include <stdlib.h>
 #include <stdio.h>
+
+#ifdef WIN32
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <sys/time.h>
+#endif
+
 #include "utility.h"
+#include "thread.h"
 
 bool isPowerOf2(uint i) {
     return (i & (i - 1)) == 0;
@@ -28,6 +37,19 @@ int nextPowerOf2(int i) {
     return i;
 }
 
+double GetPreciseTime() {
+#ifdef WIN32
+    LARGE_INTEGER frequency, count;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return double(count.QuadPart) / double(frequency.QuadPart);
+#else
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
 int sgn(int x) {
     if (x < 0) {
         return -1;
@@ -40,7 +62,7 @@ int sgn(int x) {
 
 char* va(const char* format, ...) {
     va_list argptr;
-    static char str[1024];
+    static THREAD_LOCAL char str[1024];     // so that worker threads can build error messages too
 
     va_start(argptr, format);
 #ifdef WIN32
@@ -53,10 +75,15 @@ char* va(const char* format, ...) {
     return str;
 }
 
-void SeedRandom() {
+u32 SeedRandom() {
     std::time_t curTime;
     std::time(&curTime);
     std::srand(u32(curTime));
+    return u32(curTime);
+}
+
+void SeedRandom(u32 seed) {
+    std::srand(seed);
 }
 
 int Random(int min, int max) {
@@ -113,8 +113,13 @@ struct Destroy {
 bool isPowerOf2(uint i);
 int nextPowerOf2(int i);
 
+// Seconds since some arbitrary point, to well under a millisecond.
+// For measuring how long things take, not for game logic.
+double GetPreciseTime();
+
 int sgn(int x);
-void SeedRandom();
+u32 SeedRandom();                                   ///< Seeds with the time, and returns the seed used
+void SeedRandom(u32 seed);
 int Random(int min, int max);
 char* va(const char* format, ...);
 
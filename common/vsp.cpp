@@ -12,6 +12,7 @@
 #include "base64.h"
 #include "compression.h"
 #include "vsp.h"
+#include "PackedCanvas.h"
 #include "common/utility.h"
 #include "rle.h"
 #include "fileio.h"
@@ -262,20 +263,14 @@ bool VSP::Load(const std::string& fileName) {
 					_height = std::atoi(dimNode->getChild("height")->getString().c_str());
 
 					DataNode* dataNode = tileNode->getChild("data");
-					if (dataNode->getChild("format")->getString() != "zlib") {
-						throw std::runtime_error("Unsupported data format");
-					}
+					const std::string format = dataNode->getChild("format")->getString();
 
 					std::string d64 = dataNode->getString();
-					ScopedArray<u8> compressed(new u8[d64.length()]); // way more than enough.
-					uint compressedSize;
-
-					std::string un64 = base64::decode(d64);
-					std::copy((u8*)(un64.c_str()), (u8*)(un64.c_str() + un64.length()), compressed.get());
-					compressedSize = un64.length();
+					ScopedArray<u8> compressed(new u8[base64::decodedSize(d64.length())]);
+					uint compressedSize = base64::decode(d64.data(), d64.length(), compressed.get());
 
 					ScopedArray<u8> pixels(new u8[_width * _height * numTiles * sizeof(RGBA)]);
-					Compression::decompress(compressed.get(), compressedSize, pixels.get(), _width * _height * numTiles * sizeof(RGBA));
+					Compression::unpack(format, compressed.get(), compressedSize, pixels.get(), _width * _height * numTiles * sizeof(RGBA));
 
 					tiles.clear();
 					tiles.reserve(numTiles);
@@ -484,7 +479,7 @@ void VSP::CreateTilesFromBuffer(u16* data, uint numTiles, int tilex, int tiley)
         RGBA* dest = buffer.get();
         for (int y = 0; y < _height; y++) {
             for (int x = 0; x < _width; x++) {
-                *dest++ = RGBA(*source++);
+                *dest++ = PackedCanvas::Unpack16(*source++);
             }
         }
 
@@ -1,23 +1,15 @@
 #include <cctype>
-#include <cstdlib>
 #include <sstream>
 #include <string>
 #include "animscript.h"
 #include "common/log.h"
 
-AnimScript::AnimScript()
-    : _offset(0)
-    , _count(0)
-    , _currentFrame(0)
-    , _dead(true)
+AnimProgram::AnimProgram(const std::string& script)
+    : commands(Compile(script))
 {}
 
-AnimScript::AnimScript(const std::string& script)
-    : _offset(0)
-    , _count(0)
-    , _currentFrame(0)
-    , _dead(false)
-{
+std::vector<AnimProgram::Command> AnimProgram::Compile(const std::string& script) {
+    std::vector<Command> commands;
     uint index = 0;
 
     while (index < script.length()) {
@@ -34,34 +26,71 @@ AnimScript::AnimScript(const std::string& script)
         }
 
         // get a number
-        uint end = index;
-        while (end < script.length() && std::isdigit(script[end])) {
-            ++end;
+        int amount = 0;
+        while (index < script.length() && std::isdigit(script[index])) {
+            amount = amount * 10 + (script[index] - '0');
+            ++index;
         }
 
         // force c to uppercase
         if (std::islower(c)) {
             c = char(std::toupper(c));
         }
-        commands.push_back(Command(c, std::atoi(script.substr(index, end - index).c_str())));
-        index = end;
+        commands.push_back(Command(c, amount));
     }
+
+    return commands;
 }
 
+std::string AnimProgram::toString() const {
+    std::stringstream ss;
+
+    for (uint i = 0; i < commands.size(); i++) {
+        ss << commands[i].type << commands[i].amount << ' ';
+    }
+
+    return ss.str();
+}
+
+AnimScript::AnimScript()
+    : _offset(0)
+    , _count(0)
+    , _currentFrame(0)
+    , _dead(true)
+{}
+
+AnimScript::AnimScript(const std::string& script)
+    : _program(new AnimProgram(script))
+    , _offset(0)
+    , _count(0)
+    , _currentFrame(0)
+    , _dead(false)
+{}
+
+AnimScript::AnimScript(AnimProgram* program)
+    : _program(program)
+    , _offset(0)
+    , _count(0)
+    , _currentFrame(0)
+    , _dead(program == 0)
+{}
+
 const AnimScript::Command& AnimScript::getCurrent() const {
     static Command dummy;
-    if (_offset > commands.size()) {
+    if (!_program || _offset >= _program->commands.size()) {
         return dummy;
     } else {
-        return commands[_offset];
+        return _program->commands[_offset];
     }
 }
 
 void AnimScript::update(int time) {
-    if (commands.empty() || _dead) {
+    if (isEmpty() || _dead) {
         return;
     }
 
+    const uint length = _program->commands.size();
+
     _count -= time;
 
     // used to make sure we don't loop around and around forever if the animation has no waits
@@ -69,7 +98,7 @@ void AnimScript::update(int time) {
 
     while (_count < 0) {
         const Command& cmd = getCurrent();
-        _offset = (_offset + 1) % commands.size();
+        _offset = (_offset + 1) % length;
 
         switch (cmd.type) {
             case 'F': {
@@ -100,11 +129,5 @@ void AnimScript::update(int time) {
 }
 
 std::string AnimScript::toString() const {
-    std::stringstream ss;
-
-    for (uint i = 0; i < commands.size(); i++) {
-        ss << commands[i].type << commands[i].amount << ' ';
-    }
-
-    return ss.str();
+    return _program ? _program->toString() : std::string();
 }
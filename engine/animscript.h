@@ -3,8 +3,13 @@
 #include <vector>
 #include <string>
 #include "common/utility.h"
+#include "common/refcount.h"
 
-struct AnimScript {
+/**
+ *  An animation script, parsed once.  Never changes after it's made, so any
+ *  number of AnimScripts can run the same one.
+ */
+struct AnimProgram : RefCounted {
     struct Command {
         char type;
         int amount;
@@ -20,8 +25,23 @@ struct AnimScript {
         {}
     };
 
+    explicit AnimProgram(const std::string& script);
+
+    std::string toString() const;
+
+    const std::vector<Command> commands;
+
+private:
+    static std::vector<Command> Compile(const std::string& script);
+};
+
+/// Runs an AnimProgram.  Only keeps track of where it's up to.
+struct AnimScript {
+    typedef AnimProgram::Command Command;
+
     AnimScript();
     explicit AnimScript(const std::string& script);
+    explicit AnimScript(AnimProgram* program);
 
     const Command& getCurrent() const;
 
@@ -38,14 +58,13 @@ struct AnimScript {
     std::string toString() const;
 
     inline bool isEmpty() const {
-        return commands.empty();
+        return !_program || _program->commands.empty();
     }
 
 private:
+    RefPtr<AnimProgram> _program;
     uint _offset;
     int  _count;
     uint _currentFrame;
     bool _dead;
-
-    std::vector<Command> commands;
 };
@@ -1,219 +1,361 @@
-#if 0
-#include <windows.h>
-#include <mmsystem.h>
-
-#include "graph.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "benchmark.h"
+#include "main.h"
+#include "timer.h"
+
+#include "common/Canvas.h"
+#include "common/chr.h"
+#include "common/log.h"
+#include "common/map.h"
 #include "common/utility.h"
-#include "win32.h"
-#include "log.h"
-#include "configfile.h"
+#include "common/vsp.h"
+#include "video/Driver.h"
+#include "video/Image.h"
+
+namespace {
+    const char* const tilesetName = "_benchmark.vsp";
+    const char* const spriteName  = "_benchmark.chr";
+    const char* const mapName     = "_benchmark.ika-map";
+
+    // Each sample times this many operations, so that the timer's resolution doesn't matter.
+    const int opsPerSample = 16;
+
+    Canvas RandomCanvas(int width, int height) {
+        Canvas c(width, height);
+        RGBA* p = c.GetPixels();
+        for (int i = 0; i < width * height; i++) {
+            p[i] = RGBA(Random(0, 256), Random(0, 256), Random(0, 256), Random(0, 256));
+        }
+        return c;
+    }
 
+    /// One thing to measure.  Set up in the constructor, torn down in the destructor.
+    struct Test {
+        Video::Driver* video;
 
-const int TIME_PER_TEST = 1000;  // milliseconds
-const int RIGHT_RESULT_MARGIN = 180;
+        Test(Video::Driver* v) : video(v) {}
+        virtual ~Test() {}
 
-namespace
-{
-    int testBlitImageEmpty()
-    {
-        RGBA* pTemp = new RGBA[16*16];
-        memset(pTemp, 0, 16*16*sizeof(RGBA));
+        virtual void Run() = 0;                 ///< Performs one operation.
+        virtual void Finish() {                 ///< Waits for outstanding work, so that it gets counted.
+            delete video->GrabCanvas(0, 0, 1, 1);
+        }
+    };
 
-        handle img = gfxCreateImage(16, 16);
-        gfxCopyPixelData(img, (u32*)pTemp, 16, 16);
+    struct ImageTest : Test {
+        Video::Image* image;
+        int size;
 
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
+        ImageTest(Video::Driver* v, int s)
+            : Test(v)
+            , size(s)
         {
-            count++;
-            gfxBlitImage(img, 0, 0, true);
+            Canvas c = RandomCanvas(size, size);
+            image = video->CreateImage(c);
+            video->SetBlendMode(Video::Normal);
         }
 
-        return count;
-    }
+        ~ImageTest() {
+            video->FreeImage(image);
+        }
+    };
 
-    int testBlitImageFilled()
-    {
-        RGBA* pTemp = new RGBA[16*16];
-        memset(pTemp, 255, 16*16*sizeof(RGBA));
+    struct BlitTest : ImageTest {
+        BlitTest(Video::Driver* v, int s) : ImageTest(v, s) {}
+        void Run() { video->BlitImage(image, 0, 0); }
+    };
 
-        handle img = gfxCreateImage(16, 16);
-        gfxCopyPixelData(img, (u32*)pTemp, 16, 16);
+    struct TintBlitTest : ImageTest {
+        TintBlitTest(Video::Driver* v, int s) : ImageTest(v, s) {}
+        void Run() { video->TintBlitImage(image, 0, 0, RGBA(255, 128, 64, 192)); }
+    };
 
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
-        {
-            count++;
-            gfxBlitImage(img, 0, 0, true);
+    struct ScaleBlitTest : ImageTest {
+        ScaleBlitTest(Video::Driver* v, int s) : ImageTest(v, s) {}
+        void Run() { video->ScaleBlitImage(image, 0, 0, size * 2, size * 2); }
+    };
+
+    struct RotateBlitTest : ImageTest {
+        float angle;
+        RotateBlitTest(Video::Driver* v, int s) : ImageTest(v, s), angle(0) {}
+        void Run() { video->RotateBlitImage(image, size, size, angle += 0.1f, 1.0f, 1.0f); }
+    };
+
+    struct LineTest : Test {
+        int w, h;
+        LineTest(Video::Driver* v) : Test(v), w(v->GetResolution().x), h(v->GetResolution().y) {}
+        void Run() { video->DrawLine(0, 0, w - 1, h - 1, RGBA(255, 255, 255, 128)); }
+    };
+
+    struct TriangleTest : Test {
+        int size;
+        TriangleTest(Video::Driver* v, int s) : Test(v), size(s) {}
+        void Run() {
+            int x[] = { 0, size, size };
+            int y[] = { size / 2, 0, size };
+            u32 c[] = { RGBA(255, 0, 0, 128), RGBA(0, 255, 0, 192), RGBA(0, 0, 255, 255) };
+            video->DrawTriangle(x, y, c);
         }
+    };
 
-        return count;
-    }
+    struct RectTest : Test {
+        int size;
+        RectTest(Video::Driver* v, int s) : Test(v), size(s) {}
+        void Run() { video->DrawRect(0, 0, size, size, RGBA(128, 128, 128, 128), true); }
+    };
 
-    int testBlitImageRandom()
-    {
-        RGBA* pTemp = new RGBA[16*16];
-        for (int i = 0; i<16*16; i++)
-            pTemp[i]=RGBA(Random(0, 255), Random(0, 255), Random(0, 255), Random(0, 255));
+    struct ShowPageTest : Test {
+        ShowPageTest(Video::Driver* v) : Test(v) {}
+        void Run() { video->ShowPage(); }
+    };
 
-        handle img = gfxCreateImage(16, 16);
-        gfxCopyPixelData(img, (u32*)pTemp, 16, 16);
+    // Software tests don't touch the video card, so there's nothing to wait for.
+    struct SoftTest : Test {
+        SoftTest(Video::Driver* v) : Test(v) {}
+        void Finish() {}
+    };
 
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
-        {
-            count++;
-            gfxBlitImage(img, 0, 0, true);
+    struct CanvasTest : SoftTest {
+        Canvas src;
+        Canvas dest;
+        int size;
+
+        CanvasTest(Video::Driver* v, int s)
+            : SoftTest(v)
+            , src(RandomCanvas(s, s))
+            , dest(RandomCanvas(s * 2, s * 2))
+            , size(s)
+        {}
+    };
+
+    struct CanvasBlitTest : CanvasTest {
+        CanvasBlitTest(Video::Driver* v, int s) : CanvasTest(v, s) {}
+        void Run() { Blitter::Blit(src, dest, size / 2, size / 2, Blitter::AlphaBlend()); }
+    };
+
+    struct CanvasScaleBlitTest : CanvasTest {
+        CanvasScaleBlitTest(Video::Driver* v, int s) : CanvasTest(v, s) {}
+        void Run() { Blitter::ScaleBlit(src, dest, 0, 0, size * 2, size * 2, Blitter::AlphaBlend()); }
+    };
+
+    struct CanvasTileBlitTest : CanvasTest {
+        CanvasTileBlitTest(Video::Driver* v, int s) : CanvasTest(v, s) {}
+        void Run() { Blitter::TileBlit(src, dest, 0, 0, size * 2, size * 2, 3, 5, Blitter::OpaqueBlend()); }
+    };
+
+    struct MapLoadTest : SoftTest {
+        MapLoadTest(Video::Driver* v) : SoftTest(v) {}
+        void Run() {
+            Map m;
+            m.Load(mapName);
         }
+    };
 
-        return count;
-    }
+    struct TilesetTest : Test {
+        TilesetTest(Video::Driver* v) : Test(v) {}
+        void Run() {
+            Tileset t(tilesetName, video);
+        }
+    };
+
+    struct EntityTest : SoftTest {
+        Engine* engine;
+        Sprite* sprite;
+        std::vector<Entity*> ents;
+        Tileset* oldTiles;
 
-//    int testBlitImageMask();
-//    int testTransformBlit();
-//    int testDirectBlit();
-//    int testDirectTransformBlit();
-    int testPoints()
-    {
-        handle scr = gfxGetScreenImage();
-        RGBA c(255, 255, 255, 128);
-
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
+        EntityTest(Engine* e, int count)
+            : SoftTest(e->video)
+            , engine(e)
+            , oldTiles(e->tiles)
         {
-            count++;
-            gfxSetPixel(scr, 0, 0, (u32)c);
+            engine->map.Load(mapName);
+            engine->tiles = new Tileset(tilesetName, video);
+            sprite = engine->sprite.Load(spriteName, video);
+
+            const int w = engine->map.GetLayer(0)->Width() * engine->tiles->Width();
+            const int h = engine->map.GetLayer(0)->Height() * engine->tiles->Height();
+
+            for (int i = 0; i < count; i++) {
+                Entity* ent = new Entity(engine);
+                ent->sprite = sprite;
+                ent->x = Random(0, w - sprite->nHotw);
+                ent->y = Random(0, h - sprite->nHoth);
+                ents.push_back(ent);
+                engine->entities.push_back(ent);
+            }
         }
 
-        return count;
-    }
-    int testLines()
-    {
-        handle scr = gfxGetScreenImage();
-        RGBA c(255, 255, 255, 128);
-        int x1 = 0    , y1 = 0;
-        int x2 = 319  , y2 = 239;
-
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
-        {
-            count++;
-            gfxLine(scr, x1, y1, x2, y2, (u32)c);
+        ~EntityTest() {
+            for (uint i = 0; i < ents.size(); i++) {
+                engine->entities.remove(ents[i]);
+                delete ents[i];
+            }
+            engine->sprite.Free(sprite);
+            delete engine->tiles;
+            engine->tiles = oldTiles;
         }
 
-        return count;
-    }
-//    int testGradientLines();
-//    int testTriangles();
-    int testGradientTriangles()
-    {
-        int x[] = { 0, 32, 32 };
-        int y[] = { 16, 0, 32 };
-        int c[] =
-        {
-            (u32)RGBA(255, 0, 0, 128),
-            (u32)RGBA(0, 255, 0, 192),
-            (u32)RGBA(0, 0, 255, 255)
-        };
+        void Run() {
+            const int w = engine->map.GetLayer(0)->Width() * engine->tiles->Width();
+            const int h = engine->map.GetLayer(0)->Height() * engine->tiles->Height();
+
+            for (uint i = 0; i < ents.size(); i++) {
+                Entity* ent = ents[i];
+                // Keep everybody wandering about.
+                if (ent->delayCount > 0 || !ent->isMoving) {
+                    ent->MoveTo(Random(0, w), Random(0, h));
+                }
+                ent->Update();
+            }
+        }
+    };
 
-        handle scr = gfxGetScreenImage();
+    void CreateFiles(const BenchmarkSettings& settings) {
+        VSP vsp;
+        vsp.New(16, 16, settings.tileCount);
+        for (int i = 0; i < settings.tileCount; i++) {
+            vsp.PasteTile(RandomCanvas(16, 16), i);
+        }
+        vsp.Save(tilesetName);
 
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
-        {
-            count++;
-            gfxFlatPoly(scr, x, y, c);
+        CCHRfile chr(16, 32);
+        for (int i = 1; i < 8; i++) {
+            Canvas c = RandomCanvas(16, 32);
+            chr.AppendFrame(c);
+        }
+        chr.HotY() = 16;
+        chr.HotH() = 16;
+        chr.Save(spriteName);
+
+        Map map;
+        map.title = "benchmark";
+        map.tilesetName = tilesetName;
+        map.width = settings.mapSize * 16;
+        map.height = settings.mapSize * 16;
+        for (int l = 0; l < 2; l++) {
+            Map::Layer* lay = map.AddLayer(va("layer%i", l), settings.mapSize, settings.mapSize);
+            for (int y = 0; y < settings.mapSize; y++) {
+                for (int x = 0; x < settings.mapSize; x++) {
+                    lay->tiles(x, y) = Random(0, settings.tileCount);
+                    lay->obstructions(x, y) = (l == 0 && Random(0, 10) == 0) ? 1 : 0;
+                }
+            }
         }
+        map.Save(mapName);
+    }
 
-        return count;
+    void DeleteFiles() {
+        std::remove(tilesetName);
+        std::remove(spriteName);
+        std::remove(mapName);
     }
 
-    int testRectangles()
-    {
-        RGBA c(128, 128, 128, 128);
-        handle scr = gfxGetScreenImage();
+    struct Result {
+        std::string name;
+        double opsPerSecond;
+        double percentile[3];   // 50, 95, 99
+    };
+
+    Result Measure(const std::string& name, Test* test, int timePerTest) {
+        std::vector<double> samples;    // seconds per operation
 
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
-        {
-            count++;
-            gfxRect(scr, 0, 0, 32, 32, (u32)c, true);
+        // Warm up, so that first-time costs don't skew the results.
+        test->Run();
+        test->Finish();
+
+        const double start = GetPreciseTime();
+        const double end = start + timePerTest / 1000.0;
+        double now = start;
+        int ops = 0;
+
+        while (now < end) {
+            for (int i = 0; i < opsPerSample; i++) {
+                test->Run();
+            }
+            test->Finish();
+            ops += opsPerSample;
+
+            double t = GetPreciseTime();
+            samples.push_back((t - now) / opsPerSample);
+            now = t;
         }
 
-        return count;
-    }
-//    int testGradientRectangles();
-    int testShowPage()
-    {
-        int t = timeGetTime();
-        int count = 0;
-        while (timeGetTime() - t < TIME_PER_TEST)
-        {
-            count++;
-            gfxShowPage();
+        std::sort(samples.begin(), samples.end());
+
+        Result r;
+        r.name = name;
+        r.opsPerSecond = ops / (now - start);
+
+        const double pct[] = { 0.50, 0.95, 0.99 };
+        for (int i = 0; i < 3; i++) {
+            uint index = min<uint>(samples.size() - 1, uint(samples.size() * pct[i]));
+            r.percentile[i] = samples[index] * 1000000.0;
         }
 
-        return count;
+        Log::Write("Benchmark %s: %.0f ops/sec", name.c_str(), r.opsPerSecond);
+        return r;
     }
-    
-    
-    static struct {
-        
-        // constants
-        const char* name;
-        int (*function)();
-        
-        // mutables
-        int result;
-        
-    } tests[] = {
-        { "BlitImage (empty)",   testBlitImageEmpty      },
-        { "BlitImage (filled)",  testBlitImageFilled     },
-        { "BlitImage (random)",  testBlitImageRandom     },
-//        { "BlitImageMask",       testBlitImageMask       },
-//        { "TransformBlit",       testTransformBlit       },
-//        { "DirectBlit",          testDirectBlit          },
-//        { "DirectTransformBlit", testDirectTransformBlit },
-        { "Points",              testPoints              },
-        { "Lines",               testLines               },
-//        { "Gradient Lines",      testGradientLines       },
-//        { "Triangles",           testTriangles           },
-        { "Gradient Triangles",  testGradientTriangles   },
-        { "Rectangles",          testRectangles          },
-//        { "Gradient Rectangles", testGradientRectangles  },
-        { "ShowPage",          testShowPage          },
-    };
-    const int nTests = sizeof(tests) / sizeof(*tests);
-
-};
-
-////////////////////////////////////////////////////////////////////////////////
-
-void Benchmark(HWND hwnd)
-{
-    CConfigFile cfg("user.cfg");
-
-    SetUpGraphics(cfg["graphdriver"].c_str());
-
-    gfxInit(hwnd, 320, 240, 32, false);
-
-    int i;
-    for (i = 0; i<nTests; i++)
-    {
-        tests[i].result = tests[i].function();
+}
+
+void Benchmark(Engine* engine, const BenchmarkSettings& s, const std::string& outputName) {
+    CDEBUG("benchmark");
+
+    BenchmarkSettings settings = s;
+    if (settings.timePerTest <= 0)  settings.timePerTest = 1000;
+    if (settings.imageSize <= 0)    settings.imageSize = 64;
+    if (settings.mapSize <= 0)      settings.mapSize = 100;
+    if (settings.tileCount <= 0)    settings.tileCount = 256;
+    if (settings.entityCount <= 0)  settings.entityCount = 100;
+
+    Video::Driver* video = engine->video;
+    const int size = settings.imageSize;
+
+    // Same numbers every time.
+    SeedRandom(1);
+    CreateFiles(settings);
+
+    std::vector<Result> results;
+    const int time = settings.timePerTest;
+
+#define RUN(name, test) { ScopedPtr<Test> t(new test); results.push_back(Measure(name, t.get(), time)); }
+    RUN("video.BlitImage",          BlitTest(video, size));
+    RUN("video.TintBlitImage",      TintBlitTest(video, size));
+    RUN("video.ScaleBlitImage",     ScaleBlitTest(video, size));
+    RUN("video.RotateBlitImage",    RotateBlitTest(video, size));
+    RUN("video.DrawLine",           LineTest(video));
+    RUN("video.DrawTriangle",       TriangleTest(video, size));
+    RUN("video.DrawRect",           RectTest(video, size));
+    RUN("video.ShowPage",           ShowPageTest(video));
+    RUN("canvas.Blit",              CanvasBlitTest(video, size));
+    RUN("canvas.ScaleBlit",         CanvasScaleBlitTest(video, size));
+    RUN("canvas.TileBlit",          CanvasTileBlitTest(video, size));
+    RUN("map.Load",                 MapLoadTest(video));
+    RUN("tileset.Create",           TilesetTest(video));
+    RUN("entity.Update",            EntityTest(engine, settings.entityCount));
+#undef RUN
+
+    DeleteFiles();
+
+    FILE* f = outputName == "-" ? stdout : fopen(outputName.c_str(), "w");
+    if (!f) {
+        Log::Write("Benchmark: unable to write %s", outputName.c_str());
+        return;
     }
 
-    Log::Init("benchmark.log");
-    for (i = 0; i<nTests; i++)
-        Log::Write("%20s\t%ims", tests[i].name, tests[i].result);
+    Point res = video->GetResolution();
+    fprintf(f, "# ika benchmark: resolution %ix%i, image %i, map %i, tiles %i, entities %i, %ims per test\n",
+        res.x, res.y, size, settings.mapSize, settings.tileCount, settings.entityCount, time);
+    fprintf(f, "# test\tops/sec\tp50_us\tp95_us\tp99_us\n");
+    for (uint i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(f, "%s\t%.1f\t%.3f\t%.3f\t%.3f\n", r.name.c_str(), r.opsPerSecond, r.percentile[0], r.percentile[1], r.percentile[2]);
+    }
 
-    exit(-1);
+    if (f != stdout) {
+        fclose(f);
+    }
 }
-#endif
@@ -1,2 +1,35 @@
+#pragma once
 
-extern void Benchmark(HWND hwnd);
+#include <string>
+
+struct Engine;
+
+/// Sizes the benchmarks run at.  Zero means use the default.
+struct BenchmarkSettings {
+    int timePerTest;        ///< milliseconds spent on each test
+    int imageSize;          ///< width and height of the images blitted
+    int mapSize;            ///< width and height of the generated map, in tiles
+    int tileCount;          ///< number of tiles in the generated tileset
+    int entityCount;        ///< number of entities updated per operation
+
+    BenchmarkSettings()
+        : timePerTest(0)
+        , imageSize(0)
+        , mapSize(0)
+        , tileCount(0)
+        , entityCount(0)
+    {}
+};
+
+/**
+ *  Runs every benchmark against the engine's video driver, then writes one
+ *  tab separated line per test to outputName. ("-" means standard output)
+ *
+ *  The columns are: test name, operations per second, then the 50th, 95th and
+ *  99th percentile time per operation in microseconds.  Lines starting with #
+ *  are comments.
+ *
+ *  The engine must have a video driver, but nothing else.  The map, tileset and
+ *  sprite the tests use are generated, and the files are deleted afterwards.
+ */
+void Benchmark(Engine* engine, const BenchmarkSettings& settings, const std::string& outputName);
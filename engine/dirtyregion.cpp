@@ -0,0 +1,71 @@
+#include "dirtyregion.h"
+
+namespace {
+    bool Touch(const Rect& a, const Rect& b) {
+        return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+    }
+
+    Rect Union(const Rect& a, const Rect& b) {
+        return Rect(min(a.left, b.left), min(a.top, b.top), max(a.right, b.right), max(a.bottom, b.bottom));
+    }
+}
+
+DirtyRegion::DirtyRegion()
+    : _full(false)
+{}
+
+void DirtyRegion::SetBounds(const Rect& bounds) {
+    _bounds = bounds;
+    Clear();
+}
+
+void DirtyRegion::Add(const Rect& r) {
+    if (_full) {
+        return;
+    }
+
+    Rect rect(
+        max(r.left, _bounds.left),   max(r.top, _bounds.top),
+        min(r.right, _bounds.right), min(r.bottom, _bounds.bottom));
+
+    if (rect.Width() < 1 || rect.Height() < 1) {
+        return;
+    }
+
+    // Swallow everything the new rect touches.  The result can touch others in turn, so go round again.
+    for (uint i = 0; i < _rects.size();) {
+        if (Touch(_rects[i], rect)) {
+            rect = Union(_rects[i], rect);
+            _rects.erase(_rects.begin() + i);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    _rects.push_back(rect);
+
+    if (_rects.size() > maxRects || Area() * 4 > uint(_bounds.Width() * _bounds.Height()) * 3) {
+        AddAll();
+    }
+}
+
+void DirtyRegion::AddAll() {
+    _rects.clear();
+    if (_bounds.Width() > 0 && _bounds.Height() > 0) {
+        _rects.push_back(_bounds);
+    }
+    _full = true;
+}
+
+void DirtyRegion::Clear() {
+    _rects.clear();
+    _full = false;
+}
+
+uint DirtyRegion::Area() const {
+    uint area = 0;
+    for (uint i = 0; i < _rects.size(); i++) {
+        area += _rects[i].Width() * _rects[i].Height();
+    }
+    return area;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "common/types.h"
+
+/**
+ *  The parts of the screen that have to be redrawn this frame.
+ *
+ *  Kept as a handful of rectangles.  Rectangles that overlap or touch are
+ *  merged, and once there are too many, or they cover most of the screen, the
+ *  whole screen is marked instead.  Redrawing a little too much is cheaper
+ *  than drawing the same thing once per rectangle.
+ */
+struct DirtyRegion {
+    DirtyRegion();
+
+    void SetBounds(const Rect& bounds);                     ///< The screen.  Also empties the region.
+    void Add(const Rect& r);                                ///< Clipped to the bounds.
+    void AddAll();                                          ///< Marks the whole screen.
+    void Clear();
+
+    inline bool IsEmpty() const                     { return _rects.empty(); }
+    inline bool IsFull() const                      { return _full; }
+    inline const std::vector<Rect>& Rects() const   { return _rects; }
+    uint Area() const;                                      ///< in pixels
+
+private:
+    static const uint maxRects = 16;
+
+    Rect _bounds;
+    std::vector<Rect> _rects;                               ///< Don't overlap or touch each other.
+    bool _full;
+};
@@ -35,6 +35,7 @@ Entity::Entity(Engine* njin)
     , moveScript(0)
     , activateScript(0)
     , adjActivateScript(0)
+    , scriptObject(0)
 {}
 
 Entity::Entity(Engine* njin, const Map::Entity& e, uint _layerIndex)
@@ -70,6 +71,7 @@ Entity::Entity(Engine* njin, const Map::Entity& e, uint _layerIndex)
     , moveScript(0)
     , activateScript(0)
     , adjActivateScript(0)
+    , scriptObject(0)
 {}
 
 void Entity::UpdateAnimation() {
@@ -88,9 +90,9 @@ void Entity::UpdateAnimation() {
     }
 }
 
-void Entity::SetAnimScript(const std::string& newScript) {
-    if (!newScript.empty()) {
-        defaultAnim = AnimScript(newScript);
+void Entity::SetAnimScript(AnimProgram* program) {
+    if (program) {
+        defaultAnim = AnimScript(program);
         // immediately update the frame
         UpdateAnimation();
     }
@@ -111,7 +113,7 @@ void Entity::Stop() {
         return;
 
     isMoving = false;
-    SetAnimScript(sprite->GetIdleScript(direction));
+    SetAnimScript(sprite->GetIdleProgram(direction));
 }
 
 // Handles all the nasty stuff required to make entities "slide" along a surface if they walk diagonally into it.
@@ -178,7 +180,7 @@ void Entity::Move(Direction d) {
 
     if (direction != olddir || !isMoving) {
         isMoving = true;
-        SetAnimScript(sprite->GetWalkScript(direction));
+        SetAnimScript(sprite->GetWalkProgram(direction));
     }
 
     int newx = x;
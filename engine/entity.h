@@ -62,6 +62,8 @@ public:
     ScriptObject activateScript;                                    ///< event to be called when the entity is activated
     ScriptObject adjActivateScript;                                 ///< event to be called when the entity touches the player
     ScriptObject renderScript;                                      ///< Script to be called when the entity ought to be drawn
+
+    void*       scriptObject;                                       ///< Python object reflecting this entity.  Not a reference; set and cleared by the script engine.
     
     Entity(Engine* njin);                                           ///< Default constructor
     Entity(Engine* njin, const Map::Entity& e, uint _layerIndex);   ///< Converts a map entity
@@ -70,7 +72,7 @@ public:
     void        Free();                                             ///< cleanup
     
     void        UpdateAnimation();                                  ///< update the entity's frame based on its active animation script
-    void        SetAnimScript(const std::string& newScript);        ///< makes the entity animate according to the specified script
+    void        SetAnimScript(AnimProgram* program);                ///< makes the entity animate according to the specified script.  Does nothing if it is 0
 
     void        SetFace(Direction d);                               ///< Makes the entity face the specified direction. (and stop)
 
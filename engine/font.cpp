@@ -14,8 +14,12 @@ namespace Ika {
     static const char subsetMarker = '~';
     static const char colourMarker = '#';
 
+    bool Font::releaseCanvases = false;
+
     Font::Font(const std::string& filename, Video::Driver* v)
-        : _video(v)
+        : _fileName(filename)
+        , _fontFile(new FontFile)
+        , _video(v)
         , _width(0)
         , _height(0)
         , _tabSize(30)
@@ -25,16 +29,29 @@ namespace Ika {
     {
         CDEBUG("cfont::loadfnt");
 
-        if (!_fontFile.Load(filename.c_str())) {
+        if (!_fontFile->Load(filename.c_str())) {
             throw FontException();
         }
 
-        _glyphs.resize(_fontFile.NumGlyphs());
+        _glyphs.resize(_fontFile->NumGlyphs());
+        _glyphWidths.resize(_fontFile->NumGlyphs());
 
-        for (uint i = 0; i < _fontFile.NumGlyphs(); i++) {
-            const Canvas& glyph = _fontFile.GetGlyph(i);
+        for (uint i = 0; i < _fontFile->NumGlyphs(); i++) {
+            const Canvas& glyph = _fontFile->GetGlyph(i);
             _width = max<uint>(_width, glyph.Width());
             _height = max<uint>(_height, glyph.Height());
+            _glyphWidths[i] = glyph.Width();
+        }
+
+        for (uint i = 0; i < _fontFile->NumSubSets(); i++) {
+            _subSets.push_back(_fontFile->GetSubSet(i));
+        }
+
+        if (releaseCanvases) {
+            for (uint i = 0; i < _glyphs.size(); i++) {
+                GetImage(i);
+            }
+            _fontFile = 0;
         }
     }
 
@@ -47,16 +64,18 @@ namespace Ika {
     }
 
     uint Font::GetGlyphIndex(char c, uint subset) const {
-        if (subset >= 0 && subset < _fontFile.NumSubSets()) {
-            return _fontFile.GetSubSet(subset).glyphIndex[(int)c];
+        if (subset >= 0 && subset < _subSets.size()) {
+            return _subSets[subset].glyphIndex[(int)c];
         } else {
             return 0;
         }
     }
 
     Video::Image* Font::GetGlyphImage(char c, uint subset) {
-        uint glyphIndex = GetGlyphIndex(c, subset);
+        return GetImage(GetGlyphIndex(c, subset));
+    }
 
+    Video::Image* Font::GetImage(uint glyphIndex) {
         if (glyphIndex >= _glyphs.size()) {
             return 0;
         }
@@ -64,15 +83,32 @@ namespace Ika {
         Video::Image* img = _glyphs[glyphIndex];
 
         if (!img) {
-            img = _video->CreateImage(const_cast<Canvas&>(_fontFile.GetGlyph(glyphIndex)));
+            img = _video->CreateImage(const_cast<Canvas&>(Glyphs().GetGlyph(glyphIndex)));
             _glyphs[glyphIndex] = img;
         }
 
         return img;
     }
 
+    const FontFile& Font::Glyphs() const {
+        if (!_fontFile) {
+            Log::Write("Reloading font %s", _fileName.c_str());
+            _fontFile = new FontFile;
+            if (!_fontFile->Load(_fileName.c_str())) {
+                _fontFile = 0;
+                throw FontException();
+            }
+        }
+        return *_fontFile;
+    }
+
     const Canvas& Font::GetGlyphCanvas(char c, uint subset) const {
-        return _fontFile.GetGlyph(GetGlyphIndex(c, subset));
+        return Glyphs().GetGlyph(GetGlyphIndex(c, subset));
+    }
+
+    int Font::GetGlyphWidth(char c, uint subset) const {
+        uint index = GetGlyphIndex(c, subset);
+        return index < _glyphWidths.size() ? _glyphWidths[index] : 0;
     }
 
     void Font::PrintChar(int& x, int y, uint subset, char c, RGBA colour) {
@@ -91,7 +127,7 @@ namespace Ika {
         //    return;
         //}
 
-        assert(GetGlyphIndex(c, subset) < _fontFile.NumGlyphs());  // paranoia check
+        assert(GetGlyphIndex(c, subset) < _glyphWidths.size());  // paranoia check
 
         Canvas& glyph = const_cast<Canvas&>(GetGlyphCanvas(c, subset));
 
@@ -121,12 +157,11 @@ namespace Ika {
     }
 
     template <typename Printer>
-    void Font::PaintString(int startx, int starty, const std::string& s, Printer& print) {
-        int cursubset = 0;
+    void Font::PaintString(int startx, int starty, const std::string& s, Printer& print, uint subset, RGBA colour) {
+        int cursubset = subset;
         int x = startx;
         int y = starty;
         uint len = s.length();
-        RGBA colour(255, 255, 255, 255);
 
         for (uint i = 0; i < len; i++) {
             switch (s[i]) {
@@ -148,7 +183,7 @@ namespace Ika {
                         break;  // Subset marker at end of string.  Just print it.
                     }
 
-                    if (i < len && s[i] >= '0' && s[i] <= '0' + static_cast<char>(_fontFile.NumSubSets())) {
+                    if (i < len && s[i] >= '0' && s[i] <= '0' + static_cast<char>(_subSets.size())) {
                         // ~ followed by a digit is not printed.  the subset is instead changed.
                         cursubset = s[i] - '0';
                         continue;
@@ -246,8 +281,7 @@ namespace Ika {
             {}
 
             inline void operator ()(int& x, int /*y*/, int subset, char c, RGBA /*colour*/, Font* font) {
-                const Canvas& glyph = font->GetGlyphCanvas(c, subset);
-                x += glyph.Width() + font->LetterSpacing();
+                x += font->GetGlyphWidth(c, subset) + font->LetterSpacing();
                 if (c == ' ')
                     x += font->WordSpacing();
                 width = max(width, x);
@@ -269,6 +303,70 @@ namespace Ika {
                 height = max(height, y);
             }
         };        
+
+        // Does the work of CountWidth and CountHeight in one pass.
+        struct CountExtent {
+            CountWidth widthCounter;
+            CountHeight heightCounter;
+
+            inline void operator ()(int& x, int& y, int subset, char c, RGBA colour, Font* font) {
+                widthCounter(x, y, subset, c, colour, font);
+                heightCounter(x, y, subset, c, colour, font);
+            }
+        };
+
+        struct RecordGlyphs {
+            struct Placement {
+                TextLayout::Glyph glyph;
+                int advance;
+                bool isSpace;
+            };
+
+            std::vector<Placement> placements;
+
+            inline void operator ()(int& x, int y, int subset, char c, RGBA colour, Font* font) {
+                uint index = font->GetGlyphIndex(c, subset);
+                Video::Image* img = font->GetGlyphImage(c, subset);
+
+                if (img) {
+                    Placement p;
+                    p.glyph.x = x;
+                    p.glyph.y = y;
+                    p.glyph.index = index;
+                    p.glyph.colour = colour;
+                    p.advance = img->Width() + font->LetterSpacing() + (c == ' ' ? font->WordSpacing() : 0);
+                    p.isSpace = (c == ' ');
+                    placements.push_back(p);
+
+                    x += p.advance;
+                }
+            }
+        };
+
+        // Tints glyphs like TintBlitImage does, then alpha blends them.  Blank pixels are
+        // simply replaced, so text rendered onto a clear canvas keeps its true colours.
+        struct TintBlend : Blitter::AlphaBlend {
+            RGBA tint;
+
+            TintBlend(RGBA t)
+                : tint(t)
+            {}
+
+            inline virtual RGBA operator()(RGBA src, RGBA dest) const {
+                src.r = src.r * tint.r / 255;
+                src.g = src.g * tint.g / 255;
+                src.b = src.b * tint.b / 255;
+                src.a = src.a * tint.a / 255;
+
+                if (dest.a == 0) {
+                    return src;
+                } else {
+                    return Blitter::AlphaBlend::operator()(src, dest);
+                }
+            }
+        };
+
+        const uint maxCachedExtents = 64;
     }
 
     void Font::PrintString(int x, int y, const std::string& s) {
@@ -283,15 +381,160 @@ namespace Ika {
     }
 
     int Font::StringWidth(const std::string& s) {
-        CountWidth counter;
-        PaintString(0, 0, s, counter);
-        return counter.width;
+        return Measure(s).width;
     }
     
     int Font::StringHeight(const std::string& s) {
-        CountHeight counter;
-        PaintString(0, 0, s, counter);
-        return counter.height;
+        return Measure(s).height;
     }    
 
+    const Font::Extent& Font::Measure(const std::string& s) {
+        ExtentMap::iterator iter = _extentMap.find(s);
+        if (iter != _extentMap.end()) {
+            // Move it to the front, so it's the last to be evicted.
+            _extents.splice(_extents.begin(), _extents, iter->second);
+            return iter->second->second;
+        }
+
+        CountExtent counter;
+        PaintString(0, 0, s, counter);
+
+        Extent extent;
+        extent.width = counter.widthCounter.width;
+        extent.height = counter.heightCounter.height;
+
+        _extents.push_front(std::make_pair(s, extent));
+        _extentMap[s] = _extents.begin();
+
+        if (_extentMap.size() > maxCachedExtents) {
+            _extentMap.erase(_extents.back().first);
+            _extents.pop_back();
+        }
+
+        return _extents.front().second;
+    }
+
+    void Font::FlushExtents() {
+        _extentMap.clear();
+        _extents.clear();
+    }
+
+    /*
+     * Wrapping works on the glyphs after they've been placed, rather than on the string.
+     * Whenever a glyph would run past wrapWidth, the line is broken after the last space
+     * on it, or just before that glyph if there is no space.  Everything past the break
+     * is shifted left to the margin and down a line.  A glyph that's wider than wrapWidth
+     * all by itself still gets a line of its own.
+     */
+    void Font::LayoutString(const std::string& s, int wrapWidth, TextLayout& layout, uint subset, RGBA colour) {
+        RecordGlyphs recorder;
+        PaintString(0, 0, s, recorder, subset, colour);
+
+        std::vector<RecordGlyphs::Placement>& placements = recorder.placements;
+        const int lineHeight = int(_height) + _lineSpacing;
+
+        std::vector<int> lineStarts(placements.size(), 0);    // x of the left margin for each glyph
+        std::vector<int> lineShifts(placements.size(), 0);    // number of wrapped lines above each glyph
+        std::vector<bool> dropped(placements.size(), false);  // spaces swallowed by a line break
+
+        int lineStart = 0;
+        int lineShift = 0;
+        int lineY = placements.empty() ? 0 : placements[0].glyph.y;
+        uint lineBegin = 0;
+        int lastSpace = -1;
+        bool wrapped = false;
+
+        for (uint i = 0; i < placements.size(); i++) {
+            const RecordGlyphs::Placement& p = placements[i];
+
+            if (p.glyph.y != lineY) {
+                // explicit newline.
+                lineY = p.glyph.y;
+                lineStart = 0;
+                lineBegin = i;
+                lastSpace = -1;
+                wrapped = false;
+            }
+
+            if (wrapped && i == lineBegin && p.isSpace) {
+                // leading whitespace on a wrapped line
+                dropped[i] = true;
+                lineBegin++;
+                lineStart += p.advance;
+                continue;
+            }
+
+            if (p.isSpace) {
+                lastSpace = i;
+            }
+
+            lineStarts[i] = lineStart;
+            lineShifts[i] = lineShift;
+
+            if (wrapWidth <= 0 || i == lineBegin || p.glyph.x - lineStart + p.advance <= wrapWidth) {
+                continue;
+            }
+
+            lineShift++;
+            if (lastSpace > int(lineBegin)) {
+                // Break at the space, and lay the rest of the word out again on the new line.
+                dropped[lastSpace] = true;
+                lineBegin = lastSpace + 1;
+            } else {
+                // No space to break at.  Break before this glyph, and lay it out again on the new line.
+                lineBegin = i;
+            }
+
+            i = lineBegin - 1;
+            lineStart = (lineBegin < placements.size()) ? placements[lineBegin].glyph.x : 0;
+            lastSpace = -1;
+            wrapped = true;
+        }
+
+        layout.glyphs.clear();
+        layout.width = 0;
+        layout.height = 0;
+
+        for (uint i = 0; i < placements.size(); i++) {
+            if (dropped[i]) {
+                continue;
+            }
+
+            TextLayout::Glyph g = placements[i].glyph;
+            g.x -= lineStarts[i];
+            g.y += lineShifts[i] * lineHeight;
+
+            layout.width = max(layout.width, g.x + placements[i].advance);
+            layout.height = max(layout.height, g.y + lineHeight);
+            layout.glyphs.push_back(g);
+        }
+    }
+
+    Canvas* Font::RenderString(const std::string& s, uint subset, RGBA colour) {
+        TextLayout layout;
+        LayoutString(s, 0, layout, subset, colour);
+
+        Canvas* canvas = new Canvas(max(1, layout.width), max(1, layout.height));
+
+        for (uint i = 0; i < layout.glyphs.size(); i++) {
+            const TextLayout::Glyph& g = layout.glyphs[i];
+            Blitter::Blit(Glyphs().GetGlyph(g.index), *canvas, g.x, g.y, TintBlend(g.colour));
+        }
+
+        return canvas;
+    }
+
+    void Font::PrintLayout(int x, int y, const TextLayout& layout) {
+        _video->SetBlendMode(Video::Normal);
+
+        for (uint i = 0; i < layout.glyphs.size(); i++) {
+            const TextLayout::Glyph& g = layout.glyphs[i];
+            Video::Image* img = GetImage(g.index);
+
+            if (img) {
+                _video->TintBlitImage(img, x + g.x, y + g.y, g.colour.i);
+            }
+        }
+    }
+
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <list>
+#include <map>
+
 #include "video/Driver.h"
 #include "common/utility.h"
 #include "common/fontfile.h"
@@ -11,6 +14,27 @@ struct File;
 namespace Ika {
     struct FontException{};
 
+    /**
+     * A string that has been run through a font once, with the position and colour of
+     * every glyph worked out ahead of time.  Drawing it again doesn't need to look at
+     * the string at all.
+     */
+    struct TextLayout {
+        struct Glyph {
+            int x, y;
+            uint index;             ///< Index into the font's glyph table.
+            RGBA colour;
+        };
+
+        std::vector<Glyph> glyphs;
+        int width, height;          ///< Size of the laid out text, in pixels.
+
+        TextLayout()
+            : width(0)
+            , height(0)
+        {}
+    };
+
     /**
     * Encapsulates a hardware dependant copy of a bitmap font.
     *
@@ -25,12 +49,14 @@ namespace Ika {
 
         Video::Image* GetGlyphImage(char c, uint subset);
         const Canvas& GetGlyphCanvas(char c, uint subset) const;
+        int GetGlyphWidth(char c, uint subset) const;
 
         void PrintChar(int& x, int y, uint subset, char c, RGBA colour);
         void PrintChar(int& x, int y, uint subset, char c, RGBA colour, Canvas& dest, Video::BlendMode blendMode);
 
+        /// Draws the string somewhere, starting in the subset and colour given.
         template <typename Printer>
-        void PaintString(int x, int y, const std::string& s, Printer& print);  ///< Draws the string somewhere.
+        void PaintString(int x, int y, const std::string& s, Printer& print, uint subset = 0, RGBA colour = RGBA(255, 255, 255, 255));
 
         void PrintString(int x, int y, const std::string& s);                  ///< Draws the string to the screen
         void PrintString(int x, int y, const std::string& s, Canvas& dest, Video::BlendMode blendMode);  ///< Draws the string on a canvas.
@@ -38,19 +64,51 @@ namespace Ika {
         int StringWidth(const std::string& s);                            ///< Returns the width, in pixels, of the string, if printed in this font.
         int StringHeight(const std::string& s);                           ///< Returns the height, in pixels, of the string, if printed in this font.
 
+        /// Lays the string out into layout.  If wrapWidth is positive, lines are broken at
+        /// spaces (or anywhere, if a word does not fit) so that none is wider than that.
+        void LayoutString(const std::string& s, int wrapWidth, TextLayout& layout, uint subset = 0, RGBA colour = RGBA(255, 255, 255, 255));
+        void PrintLayout(int x, int y, const TextLayout& layout);         ///< Draws a laid out string to the screen.
+
+        /// Renders the whole string onto a new canvas, just big enough to hold it.  The caller owns the result.
+        Canvas* RenderString(const std::string& s, uint subset = 0, RGBA colour = RGBA(255, 255, 255, 255));
+
         uint Width()  const { return _width; }                            ///< Returns the width of the widest char in the font.
         uint Height() const { return _height; }                           ///< Returns the height of the highest char in the font.
         int TabSize() const { return _tabSize; }                          ///< Returns the tab granularity.
         int LetterSpacing() const { return _letterSpacing; }              ///< Returns the letter spacing.
         int WordSpacing() const { return _wordSpacing; }                  ///< Returns the word spacing.
         int LineSpacing() const { return _lineSpacing; }                  ///< Returns the line spacing.
-        void SetTabSize(int tabsize) { _tabSize = tabsize; }              ///< Sets the tab granularity.
-        void SetLetterSpacing(int spacing) { _letterSpacing = spacing; }  ///< Sets the letter spacing, in pixels.
-        void SetWordSpacing(int spacing) { _wordSpacing = spacing; }      ///< Sets the word spacing, in pixels.
-        void SetLineSpacing(int spacing) { _lineSpacing = spacing; }      ///< Sets the line spacing, in pixels.
+        void SetTabSize(int tabsize) { _tabSize = tabsize; FlushExtents(); }              ///< Sets the tab granularity.
+        void SetLetterSpacing(int spacing) { _letterSpacing = spacing; FlushExtents(); }  ///< Sets the letter spacing, in pixels.
+        void SetWordSpacing(int spacing) { _wordSpacing = spacing; FlushExtents(); }      ///< Sets the word spacing, in pixels.
+        void SetLineSpacing(int spacing) { _lineSpacing = spacing; FlushExtents(); }      ///< Sets the line spacing, in pixels.
+
+        /// If true, fonts upload every glyph as soon as they're loaded and let go of the
+        /// pixels.  The file is read again if something needs them, like printing to a canvas.
+        static bool releaseCanvases;
 
     private:
-        FontFile _fontFile;
+        /// Measured size of a string.  The most recently measured strings are kept around,
+        /// since scripts tend to measure the same text over and over.
+        struct Extent {
+            int width, height;
+        };
+
+        typedef std::list<std::pair<std::string, Extent> >  ExtentList;
+        typedef std::map<std::string, ExtentList::iterator> ExtentMap;
+
+        const Extent& Measure(const std::string& s);
+        void FlushExtents();
+        Video::Image* GetImage(uint glyphIndex);
+        const FontFile& Glyphs() const;                    ///< Returns the glyph pixels, loading them again if they were released.
+
+        ExtentList _extents;   ///< Most recently used first.
+        ExtentMap _extentMap;
+
+        std::string _fileName;
+        mutable ScopedPtr<FontFile> _fontFile;             ///< Null if the glyphs have been released.
+        std::vector<FontFile::SSubSet> _subSets;           ///< Kept separately, so they outlive _fontFile.
+        std::vector<int> _glyphWidths;
 
         Video::Driver*  _video;
         std::vector<Video::Image*> _glyphs;
@@ -0,0 +1,136 @@
+#include <algorithm>
+
+#include "framestats.h"
+#include "font.h"
+#include "timer.h"
+
+#include "common/utility.h"
+#include "video/Driver.h"
+
+const char* const FrameStats::phaseNames[FrameStats::numPhases] = {
+    "input", "tick", "layers", "entities", "hooks", "showpage", "other"
+};
+
+namespace {
+    // Graph colours, one per phase.
+    const u32 phaseColours[FrameStats::numPhases] = {
+        RGBA(255, 255,   0, 192),   // input
+        RGBA(  0, 255,   0, 192),   // tick
+        RGBA(  0, 128, 255, 192),   // layers
+        RGBA(  0, 255, 255, 192),   // entities
+        RGBA(255,   0, 255, 192),   // hooks
+        RGBA(255,   0,   0, 192),   // showpage
+        RGBA(160, 160, 160, 192),   // other
+    };
+
+    const uint graphFrames = 100;       // How many frames the graph shows
+    const int graphHeight = 50;         // Pixels.  One per millisecond.
+}
+
+FrameStats::Scope::Scope(FrameStats& stats, Phase phase)
+    : _stats(stats)
+    , _previous(stats._phase)
+{
+    _stats.Switch(phase);
+}
+
+FrameStats::Scope::~Scope() {
+    _stats.Switch(_previous);
+}
+
+FrameStats::FrameStats()
+    : _frames(windowSize)
+    , _next(0)
+    , _count(0)
+    , _phase(other)
+    , _phaseStart(GetPreciseTime())
+    , _frameStart(_phaseStart)
+{
+    std::fill(_current.time, _current.time + numPhases + 1, 0.0f);
+}
+
+void FrameStats::Switch(Phase phase) {
+    double now = GetPreciseTime();
+    _current.time[_phase] += float((now - _phaseStart) * 1000.0);
+    _phaseStart = now;
+    _phase = phase;
+}
+
+void FrameStats::EndFrame() {
+    Switch(_phase);
+
+    _current.time[frame] = float((_phaseStart - _frameStart) * 1000.0);
+    _frames[_next] = _current;
+    _next = (_next + 1) % windowSize;
+    _count = min(_count + 1, windowSize);
+
+    std::fill(_current.time, _current.time + numPhases + 1, 0.0f);
+    _frameStart = _phaseStart;
+}
+
+uint FrameStats::FrameCount() const {
+    return _count;
+}
+
+double FrameStats::Percentile(int phase, double p) const {
+    if (_count == 0 || phase < 0 || phase > frame) {
+        return 0;
+    }
+
+    std::vector<float> times(_count);
+    for (uint i = 0; i < _count; i++) {
+        times[i] = _frames[i].time[phase];
+    }
+
+    uint index = min<uint>(_count - 1, uint(p * _count));
+    std::nth_element(times.begin(), times.begin() + index, times.end());
+    return times[index];
+}
+
+void FrameStats::Histogram(std::vector<uint>& buckets) const {
+    buckets.assign(histogramSize, 0);
+    for (uint i = 0; i < _count; i++) {
+        uint ms = uint(_frames[i].time[frame]);
+        buckets[min(ms, histogramSize - 1)]++;
+    }
+}
+
+void FrameStats::Draw(Video::Driver* video, Ika::Font* font, int x, int y) const {
+    const int lineHeight = font->Height();
+    const int width = graphFrames * 2;
+    const int height = lineHeight * (numPhases + 2) + graphHeight + 4;
+
+    Video::BlendMode oldMode = video->SetBlendMode(Video::Normal);
+    video->DrawRect(x, y, x + width, y + height, RGBA(0, 0, 0, 160), true);
+
+    font->PrintString(x + 2, y, "phase      p50   p95   p99");
+    for (int phase = 0; phase <= frame; phase++) {
+        const char* name = phase == frame ? "frame" : phaseNames[phase];
+        font->PrintString(x + 2, y + lineHeight * (phase + 1), va("%-8s %5.1f %5.1f %5.1f",
+            name, Percentile(phase, 0.50), Percentile(phase, 0.95), Percentile(phase, 0.99)));
+    }
+
+    // Stacked bars, newest on the right.  A line marks 60fps.
+    const int graphTop = y + lineHeight * (numPhases + 2) + 2;
+    const int graphBottom = graphTop + graphHeight;
+    const uint shown = min(_count, graphFrames);
+
+    for (uint i = 0; i < shown; i++) {
+        const Frame& f = _frames[(_next + windowSize - shown + i) % windowSize];
+        const int barX = x + width - (shown - i) * 2;
+
+        float bottom = graphBottom;
+        for (int phase = 0; phase < numPhases && bottom > graphTop; phase++) {
+            float top = max<float>(graphTop, bottom - f.time[phase]);
+            if (int(bottom) > int(top)) {
+                video->DrawRect(barX, int(top), barX, int(bottom) - 1, phaseColours[phase], true);
+            }
+            bottom = top;
+        }
+    }
+
+    const int target = graphBottom - 1000 / 60;
+    video->DrawLine(x, target, x + width, target, RGBA(255, 255, 255, 128));
+
+    video->SetBlendMode(oldMode);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "common/types.h"
+
+namespace Video {
+    struct Driver;
+}
+
+namespace Ika {
+    struct Font;
+}
+
+/**
+ *  Remembers how long the last few hundred frames took, and what the time was spent on.
+ *
+ *  Time is charged to whichever phase is innermost when it passes.  Anything that
+ *  isn't inside a Scope (mostly the game's own script code) counts as "other".
+ *  A frame ends whenever the engine shows a page.
+ */
+struct FrameStats {
+    enum Phase {
+        input,          ///< CheckMessages
+        tick,           ///< GameTick: timer hooks, entity AI
+        layers,         ///< RenderLayer
+        entities,       ///< RenderEntities
+        hooks,          ///< retrace hooks
+        showPage,       ///< the video driver's ShowPage
+        other,          ///< everything else
+        numPhases,
+
+        frame = numPhases   ///< Pass to Percentile to get whole frame times.
+    };
+
+    static const char* const phaseNames[numPhases];
+
+    /// Charges the time between construction and destruction to a phase.
+    /// Time spent in nested scopes is not counted twice.
+    struct Scope {
+        Scope(FrameStats& stats, Phase phase);
+        ~Scope();
+
+    private:
+        FrameStats& _stats;
+        Phase _previous;
+    };
+
+    static const uint windowSize = 300;                     ///< Number of frames remembered
+    static const uint histogramSize = 50;                   ///< One bucket per millisecond.  Slower frames go in the last one.
+
+    FrameStats();
+
+    void EndFrame();                                        ///< Call after every page flip.
+
+    uint FrameCount() const;                                ///< Number of frames remembered so far
+    double Percentile(int phase, double p) const;           ///< In milliseconds.  p ranges from 0 to 1.
+    void Histogram(std::vector<uint>& buckets) const;       ///< Counts frames by how many milliseconds they took.
+
+    void Draw(Video::Driver* video, Ika::Font* font, int x, int y) const;  ///< Draws percentiles and a graph of recent frames.
+
+private:
+    struct Frame {
+        float time[numPhases + 1];                          ///< milliseconds per phase, then the total
+    };
+
+    void Switch(Phase phase);                               ///< Charges time to the current phase, and makes another current.
+
+    std::vector<Frame> _frames;                             ///< ring buffer
+    uint _next;                                             ///< where the next frame goes in _frames
+    uint _count;                                            ///< number of frames in _frames
+
+    Frame _current;
+    Phase _phase;
+    double _phaseStart;
+    double _frameStart;
+};
@@ -0,0 +1,214 @@
+#include <cstring>
+
+#include "journal.h"
+#include "timer.h"
+
+namespace {
+    const char journalMagic[4] = { 'I', 'K', 'A', 'J' };
+    const u32 journalVersion = 2;     // 2: key modifiers, and the time recording started
+}
+
+InputJournal::InputJournal()
+    : _mode(off)
+    , _seed(0)
+    , _polls(0)
+    , _time(0)
+    , _idle(0)
+    , _pending(false)
+    , _end(0)
+{}
+
+InputJournal::~InputJournal() {
+    Close();
+}
+
+bool InputJournal::StartRecording(const std::string& fileName, u32 seed) {
+    Close();
+
+    if (!_file.OpenWrite(fileName.c_str())) {
+        return false;
+    }
+
+    _mode = recording;
+    _seed = seed;
+    _polls = 0;
+    _idle = 0;
+    _pending = false;
+    _events.clear();
+
+    // Time stands still until the first poll, as it does when this is replayed.
+    _time = GetTime();
+    virtualTime = _time;
+
+    _file.Write(journalMagic, sizeof journalMagic);
+    _file.Write(journalVersion);
+    _file.Write(_seed);
+    _file.Write((s32)_time);
+    return true;
+}
+
+bool InputJournal::StartReplay(const std::string& fileName) {
+    Close();
+
+    if (!_file.OpenRead(fileName.c_str())) {
+        return false;
+    }
+
+    char magic[4];
+    u32 version = 0;
+    _file.Read(magic, sizeof magic);
+    _file.Read(version);
+    if (memcmp(magic, journalMagic, sizeof magic) != 0 || version != journalVersion) {
+        _file.Close();
+        return false;
+    }
+
+    s32 startTime = 0;
+    _file.Read(_seed);
+    _file.Read(startTime);
+    _end = _file.Size();
+
+    _mode = replaying;
+    _polls = 0;
+    _idle = 0;
+    _time = startTime;
+
+    // Time stands still until the first poll.
+    virtualTime = startTime;
+    return true;
+}
+
+void InputJournal::Close() {
+    if (_mode == recording) {
+        if (!_events.empty()) {
+            EndPoll(_time);
+        }
+        Flush();
+    }
+
+    if (_mode != off) {
+        _file.Close();
+        virtualTime = -1;
+    }
+    _mode = off;
+}
+
+void InputJournal::Record(const SDL_Event& event) {
+    if (_mode != recording) {
+        return;
+    }
+
+    Entry e = { event.type, 0, 0, 0 };
+
+    switch (event.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:             e.a = event.key.keysym.sym; e.b = event.key.keysym.mod;                             break;
+        case SDL_JOYAXISMOTION:     e.a = event.jaxis.which;    e.b = event.jaxis.axis;     e.c = event.jaxis.value;    break;
+        case SDL_JOYBUTTONDOWN:
+        case SDL_JOYBUTTONUP:       e.a = event.jbutton.which;  e.b = event.jbutton.button; e.c = event.jbutton.state;  break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:     e.a = event.button.button;                                                          break;
+        case SDL_MOUSEMOTION:       e.a = event.motion.x;       e.b = event.motion.y;                                   break;
+        case SDL_QUIT:                                                                                                  break;
+        default:                    return;     // the engine ignores it, so we can too
+    }
+
+    _events.push_back(e);
+}
+
+void InputJournal::EndPoll(int now) {
+    if (_mode != recording) {
+        return;
+    }
+
+    // Until the next poll, this is the time.  Replays can't know any other.
+    virtualTime = now;
+    _polls++;
+
+    // Scripts that wait for time to pass poll constantly.  Store runs of empty polls as a count.
+    if (_pending && _events.empty() && now == _time) {
+        _idle++;
+        return;
+    }
+
+    Flush();
+
+    _file.Write((s32)now);
+    _file.Write((u32)_events.size());
+    for (uint i = 0; i < _events.size(); i++) {
+        const Entry& e = _events[i];
+        _file.Write(e.type);
+        _file.Write(e.a);
+        _file.Write(e.b);
+        _file.Write(e.c);
+    }
+
+    _time = now;
+    _pending = true;
+    _events.clear();
+}
+
+void InputJournal::Flush() {
+    if (_pending) {
+        _file.Write((u32)_idle);
+        _idle = 0;
+        _pending = false;
+    }
+}
+
+bool InputJournal::NextPoll(std::vector<SDL_Event>& events) {
+    events.clear();
+
+    if (_mode != replaying) {
+        return false;
+    }
+
+    if (_idle > 0) {
+        _idle--;
+        _polls++;
+        return true;
+    }
+
+    if (_file.Pos() >= _end) {
+        return false;
+    }
+
+    s32 time;
+    u32 count = 0;
+    _file.Read(time);
+    _file.Read(count);
+
+    for (uint i = 0; i < count; i++) {
+        Entry e;
+        _file.Read(e.type);
+        _file.Read(e.a);
+        _file.Read(e.b);
+        _file.Read(e.c);
+
+        SDL_Event event;
+        memset(&event, 0, sizeof event);
+        event.type = e.type;
+
+        switch (e.type) {
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:             event.key.keysym.sym = (SDLKey)e.a; event.key.keysym.mod = (SDLMod)e.b;                         break;
+            case SDL_JOYAXISMOTION:     event.jaxis.which = e.a;    event.jaxis.axis = e.b;     event.jaxis.value = e.c;                break;
+            case SDL_JOYBUTTONDOWN:
+            case SDL_JOYBUTTONUP:       event.jbutton.which = e.a;  event.jbutton.button = e.b; event.jbutton.state = e.c;              break;
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:     event.button.button = e.a;                                                                      break;
+            case SDL_MOUSEMOTION:       event.motion.x = e.a;       event.motion.y = e.b;                                               break;
+        }
+
+        events.push_back(event);
+    }
+
+    u32 idle = 0;
+    _file.Read(idle);
+    _idle = idle;
+
+    _time = time;
+    _polls++;
+    virtualTime = time;
+    return true;
+}
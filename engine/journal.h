@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <SDL/SDL.h>
+
+#include "common/fileio.h"
+#include "common/types.h"
+
+/**
+ *  Records every input event the engine handles, along with the time it was
+ *  handled at, so that a play session can be fed back in exactly.
+ *
+ *  The journal is a list of polls: one for every call to Engine::CheckMessages.
+ *  While recording or replaying, the clock stands still between polls, and jumps to
+ *  the poll's time at each one, so everything between two polls sees exactly the time
+ *  that was written down.  As long as the game itself is deterministic, it runs through
+ *  the same ticks with the same input, however fast or slow the machine is.
+ */
+struct InputJournal {
+    InputJournal();
+    ~InputJournal();
+
+    bool StartRecording(const std::string& fileName, u32 seed);     ///< Returns false if the file can't be written.  Stops the clock.
+    bool StartReplay(const std::string& fileName);                  ///< Returns false if the file can't be read, or isn't a journal
+    void Close();                                                   ///< Stops recording or replaying
+
+    inline bool IsRecording() const { return _mode == recording; }
+    inline bool IsReplaying() const { return _mode == replaying; }
+    inline u32 Seed() const { return _seed; }                       ///< Random seed the session was recorded with
+    inline uint Polls() const { return _polls; }                    ///< Number of polls recorded or replayed so far
+
+    void Record(const SDL_Event& event);                            ///< Adds an event to the current poll
+    void EndPoll(int now);                                          ///< Finishes the current poll, and sets the clock to now until the next one
+
+    /// Sets the clock to the time of the next poll, and fills events with its input.
+    /// Returns false when the journal has run out.
+    bool NextPoll(std::vector<SDL_Event>& events);
+
+private:
+    enum Mode { off, recording, replaying };
+
+    // Only the parts of an event that the engine looks at.
+    struct Entry {
+        u8 type;
+        s32 a, b, c;
+    };
+
+    void Flush();
+
+    File _file;
+    Mode _mode;
+    u32 _seed;
+    uint _polls;
+
+    std::vector<Entry> _events;     ///< recording: events in the current poll
+    int _time;                      ///< time of the last poll written or read
+    uint _idle;                     ///< empty polls at _time that have yet to be written or read
+    bool _pending;                  ///< recording: true if the last poll hasn't been written yet
+    int _end;                       ///< replaying: size of the file
+};
@@ -7,28 +7,55 @@
 #include "main.h"
 
 #include "common/aries.h"
+#include "common/memstats.h"
+#include "common/thread.h"
 #include "common/utility.h"
+#include "common/trace.h"
 #include "common/version.h"
 #include "timer.h"
 
+#include "benchmark.h"
 #include "input.h"
+#include "null/Driver.h"
 #include "opengl/Driver.h"
 //#include "soft32/Driver.h"
 #include "keyboard.h"
 
+namespace {
+    /// Writes a canvas out as a PNG, then deletes it.
+    struct SaveCanvasTask : Parallel::Task {
+        Canvas* canvas;
+        const std::string fileName;
+
+        SaveCanvasTask(Canvas* c, const std::string& f)
+            : canvas(c)
+            , fileName(f)
+        {}
+
+        ~SaveCanvasTask() {
+            delete canvas;
+        }
+
+        virtual void Run(uint) {
+            canvas->Save(fileName);
+        }
+    };
+}
+
 void Engine::Sys_Error(const char* errmsg) {
     CDEBUG("sys_error");
 
 #if (defined WIN32)
-    SDL_SysWMinfo info;
-    SDL_VERSION(&info.version);
-    HWND hWnd = SDL_GetWMInfo(&info) ? info.window : HWND_DESKTOP;
+    if (!_headless) {
+        SDL_SysWMinfo info;
+        SDL_VERSION(&info.version);
+        HWND hWnd = SDL_GetWMInfo(&info) ? info.window : HWND_DESKTOP;
 
-    if (strlen(errmsg))
-        MessageBox(hWnd, errmsg, "Error", 0);
-#else
-    printf("%s", errmsg);
+        if (strlen(errmsg))
+            MessageBox(hWnd, errmsg, "Error", 0);
+    } else
 #endif
+    printf("%s", errmsg);
 
     Shutdown();
     exit(-1);
@@ -45,82 +72,124 @@ void Engine::Script_Error(std::string msg) {
     std::string err = script.GetErrorMessage() + msg;
 
 #if (defined WIN32)
-    if (!err.empty()) {
-        SDL_SysWMinfo info;
-        SDL_VERSION(&info.version);
-        HWND hWnd = SDL_GetWMInfo(&info) ? info.window : HWND_DESKTOP;
+    if (!_headless) {
+        if (!err.empty()) {
+            SDL_SysWMinfo info;
+            SDL_VERSION(&info.version);
+            HWND hWnd = SDL_GetWMInfo(&info) ? info.window : HWND_DESKTOP;
 
-        MessageBox(hWnd, err.c_str(), "Script Error", 0);
-    }
-#else
-    printf("%s", err.c_str());
+            MessageBox(hWnd, err.c_str(), "Script Error", 0);
+        }
+    } else
 #endif
+    printf("%s", err.c_str());
 
     exit(-1);
 }
 
 void Engine::CheckMessages() {
     CDEBUG("checkmessages");
+    FrameStats::Scope phase(frameStats, FrameStats::input);
 
     SDL_Event event;
 
-    while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_KEYDOWN: {
-                the<Input>()->KeyDown(event.key.keysym.sym);
-                // bottom line screenshot if F11 is pressed
-                //if (event.key.keysym.sym == SDLK_F11 && event.key.state == SDL_PRESSED)
-                //    ScreenShot();
-
-                // Alt-F4: Quit.  Now.
-                if (event.key.keysym.sym == SDLK_F4 &&
-                    (SDL_GetModState() & (KMOD_LALT | KMOD_RALT))) {
-                    Shutdown();
-                    exit(0);
-                }
-                break;
-            }
-
-            case SDL_KEYUP: {
-                the<Input>()->KeyUp(event.key.keysym.sym);
-                break;
+    if (journal.IsReplaying()) {
+        // The only thing we listen to is the window being closed.
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                Shutdown();
+                exit(0);
             }
+        }
 
-            case SDL_JOYAXISMOTION: {
-                the<Input>()->JoyAxisMove(event.jaxis.which, event.jaxis.axis, event.jaxis.value);
-                break;
-            }
+        static std::vector<SDL_Event> events;
+        static int startTime = SDL_GetTicks();
+        if (!journal.NextPoll(events)) {
+            int elapsed = SDL_GetTicks() - startTime;
+            std::string summary = va("Replay finished: %i polls, %i ticks in %i ms (%.1f ticks/sec)",
+                journal.Polls(), _tickCount, elapsed, elapsed ? _tickCount * 1000.0 / elapsed : 0.0);
+            Log::Write("%s", summary.c_str());
+            printf("%s\n", summary.c_str());
+            Shutdown();
+            exit(0);
+        }
 
-            case SDL_JOYBUTTONDOWN:
-            case SDL_JOYBUTTONUP: {
-                the<Input>()->JoyButtonChange(event.jbutton.which, event.jbutton.button, event.jbutton.state == SDL_PRESSED);
-                break;
-            }
+        for (uint i = 0; i < events.size(); i++) {
+            HandleEvent(events[i]);
+        }
+        return;
+    }
 
-            case SDL_MOUSEBUTTONDOWN: {
-                the<Input>()->MouseButtonChange(event.button.button, true);
-                break;
-            }
+    // Without a display there's no reason to wait around.  Every poll is one tick later.
+    if (_headless) {
+        virtualTime++;
+    }
 
-            case SDL_MOUSEBUTTONUP: {
-                the<Input>()->MouseButtonChange(event.button.button, false);
-                break;
-            }
+    while (SDL_PollEvent(&event)) {
+        journal.Record(event);
+        HandleEvent(event);
+    }
 
-            case SDL_MOUSEMOTION: {
-                the<Input>()->MouseMoved(event.motion.x, event.motion.y);
-                break;
-            }
+    // While recording, the clock only moves here, so whatever reads it before the next poll gets the recorded time.
+    journal.EndPoll(_headless ? virtualTime : GetRealTime());
+}
 
-            case SDL_QUIT: {
+void Engine::HandleEvent(const SDL_Event& event) {
+    switch (event.type) {
+        case SDL_KEYDOWN: {
+            the<Input>()->KeyDown(event.key.keysym.sym);
+            // bottom line screenshot if F11 is pressed
+            //if (event.key.keysym.sym == SDLK_F11 && event.key.state == SDL_PRESSED)
+            //    ScreenShot();
+
+            // Alt-F4: Quit.  Now.  (the event's own modifiers, not SDL_GetModState, so that replays see it too)
+            if (event.key.keysym.sym == SDLK_F4 &&
+                (event.key.keysym.mod & (KMOD_LALT | KMOD_RALT))) {
                 Shutdown();
                 exit(0);
-                break;
             }
+            break;
+        }
 
-            default: {
-                break;
-            }
+        case SDL_KEYUP: {
+            the<Input>()->KeyUp(event.key.keysym.sym);
+            break;
+        }
+
+        case SDL_JOYAXISMOTION: {
+            the<Input>()->JoyAxisMove(event.jaxis.which, event.jaxis.axis, event.jaxis.value);
+            break;
+        }
+
+        case SDL_JOYBUTTONDOWN:
+        case SDL_JOYBUTTONUP: {
+            the<Input>()->JoyButtonChange(event.jbutton.which, event.jbutton.button, event.jbutton.state == SDL_PRESSED);
+            break;
+        }
+
+        case SDL_MOUSEBUTTONDOWN: {
+            the<Input>()->MouseButtonChange(event.button.button, true);
+            break;
+        }
+
+        case SDL_MOUSEBUTTONUP: {
+            the<Input>()->MouseButtonChange(event.button.button, false);
+            break;
+        }
+
+        case SDL_MOUSEMOTION: {
+            the<Input>()->MouseMoved(event.motion.x, event.motion.y);
+            break;
+        }
+
+        case SDL_QUIT: {
+            Shutdown();
+            exit(0);
+            break;
+        }
+
+        default: {
+            break;
         }
     }
 }
@@ -162,14 +231,18 @@ void Engine::MainLoop() {
             font->PrintString(0, 0, va("Fps: %i", video->GetFrameRate()));
         }
 
-        video->ShowPage();
+        ShowPage();
     }
 }
 
 // TODO: Make a nice happy GUI thingie for making a user.cfg
 // This is ugly. :(
-void Engine::Startup(std::string& pathname) {
+void Engine::Startup(std::string& pathname, const EngineOptions& options) {
     CDEBUG("Startup");
+    _headless = options.headless;
+    _tickLimit = options.tickLimit;
+    _traceName = options.traceName;
+
     std::string gamePathName;
     std::string cfgPathName;
     std::string logPathName;
@@ -247,8 +320,13 @@ void Engine::Startup(std::string& pathname) {
 
     // init a few values
     _showFramerate  = cfg.Int("showfps") != 0;
+    _showFrameStats = cfg.Int("showframestats") != 0;
     _frameSkip      = min(1, cfg.Int("frameskip"));
 
+    // Tilesets and fonts can drop their pixels once they're in video memory.
+    Tileset::releaseCanvases = cfg.Int("releasecanvases") != 0;
+    Ika::Font::releaseCanvases = Tileset::releaseCanvases;
+
     // Now the tricky stuff.
     try {
         if (cfg.Int("log")) {
@@ -260,7 +338,7 @@ void Engine::Startup(std::string& pathname) {
         Log::Write("--------------------------");
 
         Log::Write("Initializing SDL");
-        SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK
+        SDL_Init((_headless ? 0 : SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) | SDL_INIT_TIMER
 #ifndef _DEBUG
             | SDL_INIT_NOPARACHUTE
 #endif
@@ -268,16 +346,21 @@ void Engine::Startup(std::string& pathname) {
 
         atexit(SDL_Quit);
 
-
+        if (!_headless) {
 #if (!defined _DEBUG)
-        SDL_WM_SetCaption(title.c_str(), 0);
+            SDL_WM_SetCaption(title.c_str(), 0);
 #else
-        SDL_WM_SetCaption(va("%s (debug)", title), 0);
+            SDL_WM_SetCaption(va("%s (debug)", title), 0);
 #endif
+        }
 
         Log::Write("Initializing Video");
         std::string driver = toLower(cfg["videodriver"]);
 
+        if (_headless) {
+            Log::Write("Starting null video driver");
+            video = new Null::Driver(xres, yres);
+        } else
 #if 0
         // disabled because it's unstable and scary. 
         if (driver == "soft" || driver == "sdl") {
@@ -302,7 +385,7 @@ void Engine::Startup(std::string& pathname) {
         }
 
 #ifdef WIN32
-        {
+        if (!_headless) {
             SDL_SysWMinfo info;
             SDL_VERSION(&info.version);
             HWND hWnd = SDL_GetWMInfo(&info) ? info.window : 0;
@@ -312,11 +395,21 @@ void Engine::Startup(std::string& pathname) {
 #endif
 
         Log::Write("Initializing Input");
-        SDL_JoystickEventState(SDL_ENABLE);
+        if (!_headless) {
+            SDL_JoystickEventState(SDL_ENABLE);
+        }
         Input::getInstance(); // force creation of the singleton instance.
 
         Log::Write("Initializing sound");
-        Sound::Init(cfg.Int("nosound") != 0);
+        Sound::Init(_headless || cfg.Int("nosound") != 0);
+
+        if (_showFrameStats) {
+            try {
+                _overlayFont = new Ika::Font("system.fnt", video);
+            } catch (Ika::FontException) {
+                Log::Write("Unable to load system.fnt.  Frame stats will not be shown.");
+            }
+        }
     } catch (Video::Exception) {
         video = 0;
         Sys_Error("Unable to set the video mode.\nAre you sure your hardware can handle the chosen settings?");
@@ -326,7 +419,41 @@ void Engine::Startup(std::string& pathname) {
         Sys_Error("An unknown error occurred during initialization.");
     }
 
-    SeedRandom();
+    if (!options.benchmarkName.empty()) {
+        BenchmarkSettings settings;
+        settings.timePerTest = cfg.Int("benchtime");
+        settings.imageSize   = cfg.Int("benchimagesize");
+        settings.mapSize     = cfg.Int("benchmapsize");
+        settings.tileCount   = cfg.Int("benchtiles");
+        settings.entityCount = cfg.Int("benchentities");
+
+        Log::Write("Running benchmarks");
+        Benchmark(this, settings, options.benchmarkName);
+        Shutdown();
+        exit(0);
+    }
+
+    // Headless time starts at zero, and only moves when the engine polls for input.
+    if (_headless) {
+        virtualTime = 0;
+    }
+    _startTime = GetPreciseTime();
+
+    if (!options.replayName.empty()) {
+        if (!journal.StartReplay(options.replayName)) {
+            Sys_Error(va("Unable to replay input from %s", options.replayName.c_str()));
+        }
+        Log::Write("Replaying input from %s", options.replayName.c_str());
+        SeedRandom(journal.Seed());
+    } else {
+        u32 seed = SeedRandom();
+        if (!options.recordName.empty()) {
+            if (!journal.StartRecording(options.recordName, seed)) {
+                Sys_Error(va("Unable to record input to %s", options.recordName.c_str()));
+            }
+            Log::Write("Recording input to %s", options.recordName.c_str());
+        }
+    }
 
     Log::Write("Initing Python");
     script.Init(this);
@@ -337,6 +464,10 @@ void Engine::Startup(std::string& pathname) {
         Script_Error();
     }
 
+    if (!options.mapName.empty()) {
+        LoadMap(options.mapName);
+    }
+
     if (!_isMapLoaded) {
         Sys_Error("");
     }
@@ -359,10 +490,46 @@ void Engine::Shutdown() {
 #endif
 
     Log::Write("---- shutdown ----");
+
+    if (_headless) {
+        double elapsed = GetPreciseTime() - _startTime;
+        std::string summary = va("Ran %i ticks in %.2f seconds (%.1f ticks/sec).  %i renders, averaging %.3f ms.",
+            _tickCount, elapsed, elapsed > 0 ? _tickCount / elapsed : 0.0,
+            _renderCount, _renderCount ? _renderTime * 1000.0 / _renderCount : 0.0);
+        Log::Write("%s", summary.c_str());
+        printf("%s\n", summary.c_str());
+    }
+
+    sprite.LogTextureMemory();
+    MemStats::Log();
+    journal.Close();
+
+    if (!_traceName.empty()) {
+        if (Trace::Dump(_traceName)) {
+            Log::Write("Trace written to %s", _traceName.c_str());
+        } else {
+            Log::Write("Unable to write trace to %s", _traceName.c_str());
+        }
+    }
+
+    // Screenshots still on their way get written.  Nobody is left to call the callbacks.
+    for (uint i = 0; i < _grabs.size(); i++) {
+        Canvas* c = video->FinishGrabCanvas(_grabs[i].ticket, true);
+        if (_grabs[i].fileName.empty()) {
+            delete c;
+        } else if (c) {
+            Parallel::Background(new SaveCanvasTask(c, _grabs[i].fileName));
+        }
+    }
+    _grabs.clear();
+    Parallel::FinishBackground();
+
     Sound::Shutdown();
     script.Shutdown();
     entities.clear();
+    _layerEntities.clear();
     Input::Destroy();
+    _overlayFont = 0;
     delete video;
     SDL_Quit();
 }
@@ -418,149 +585,201 @@ namespace {
         inline int operator () (const Entity* a, const Entity* b) const {
             return a->y < b->y;
         }
+
+        inline bool operator () (const Entity* a, int y) const {
+            return a->y < y;
+        }
+
+        inline bool operator () (int y, const Entity* b) const {
+            return y < b->y;
+        }
     };
 };
 
+void Engine::InvalidateLayerEntities() {
+    _layerEntitiesDirty = true;
+}
+
+void Engine::RebuildLayerEntities() {
+    // Clear the existing lists rather than replacing them, so we keep their storage.
+    _layerEntities.resize(map.NumLayers());
+    for (uint i = 0; i < _layerEntities.size(); i++) {
+        _layerEntities[i].clear();
+    }
+
+    for (EntityList::iterator i = entities.begin(); i != entities.end(); i++) {
+        Entity* e = *i;
+        if (e->layerIndex < _layerEntities.size()) {
+            _layerEntities[e->layerIndex].push_back(e);
+        }
+    }
+
+    for (uint i = 0; i < _layerEntities.size(); i++) {
+        std::stable_sort(_layerEntities[i].begin(), _layerEntities[i].end(), CompareEntities());
+    }
+
+    _layerEntitiesDirty = false;
+}
+
 /*
- * This could probably use some optimization.  Every time we draw the map,
- * we do n filter operations, then n sort operations.  huuurk.
- * Maybe keep the entity linked list y sorted at all times by reordering
- * whenever a y value changes.  That's only O(n) as opposed to O(nlogn) or
- * whatever unholy growth rate this is.
+ * Each layer keeps a list of its entities, sorted by y.  Entities only move a pixel or
+ * so per tick, so the list is almost sorted from one frame to the next, and an insertion
+ * sort puts it back in order in linear time.  It's only rebuilt from scratch when an entity
+ * is created, destroyed, or moved to another layer.
  *
- * Update: meh.  Sorting doesn't seem to be a bottleneck.
+ * Since the list is sorted by y, the entities that could be onscreen are a contiguous run
+ * of it, which we find with a binary search.  Only those get the full visibility test.
  */
 void Engine::RenderEntities(uint layerIndex) {
     CDEBUG("renderentities");
-    std::vector<Entity*>     drawlist;
+    FrameStats::Scope phase(frameStats, FrameStats::entities);
+
+    if (_layerEntitiesDirty) {
+        RebuildLayerEntities();
+    }
+
+    if (layerIndex >= _layerEntities.size() || _layerEntities[layerIndex].empty()) {
+        return;
+    }
+
+    EntityVector& list = _layerEntities[layerIndex];
     const Point res = video->GetResolution();
     const Map::Layer* layer = map.GetLayer(layerIndex);
 
     int xw = (xwin * layer->parallax.mulx / layer->parallax.divx) - layer->x;
     int yw = (ywin * layer->parallax.muly / layer->parallax.divy) - layer->y;
 
-    // first, get a list of entities onscreen
-    uint width, height;
-    for (EntityList::iterator i = entities.begin(); i != entities.end(); i++) {
-        Entity* e = *i;
+    // Restore y order, and find out how far any sprite reaches above and below its entity's y.
+    int reachUp = 0;
+    int reachDown = 0;
+    for (uint i = 0; i < list.size(); i++) {
+        Entity* e = list[i];
+
+        if (e->sprite) {
+            reachUp = max(reachUp, e->sprite->nHoty);
+            reachDown = max(reachDown, (int)e->sprite->Height() - e->sprite->nHoty);
+        }
+
+        uint j = i;
+        while (j > 0 && e->y < list[j - 1]->y) {
+            list[j] = list[j - 1];
+            j--;
+        }
+        list[j] = e;
+    }
+
+    const int top = yw - layer->y - reachDown;
+    const int bottom = yw - layer->y + res.y + reachUp;
+    const uint first = std::lower_bound(list.begin(), list.end(), top, CompareEntities()) - list.begin();
+    const uint last = std::upper_bound(list.begin(), list.end(), bottom, CompareEntities()) - list.begin();
+
+    video->SetBlendMode(Video::Normal);
+
+    // Render scripts can create or destroy entities, so don't hang on to iterators.
+    for (uint i = first; i < last && i < _layerEntities[layerIndex].size(); i++) {
+        const Entity* e = _layerEntities[layerIndex][i];
         const Sprite* sprite = e->sprite;
 
-        if (e->layerIndex != layerIndex)    continue;   // wrong layer
-        if (!sprite)                        continue;   // no sprite? @_x
+        if (!sprite || !e->isVisible)       continue;   // no sprite? @_x
 
-        width = sprite->Width();
-        height = sprite->Height();
+        const int width = sprite->Width();
+        const int height = sprite->Height();
 
         // get the coodinates at which the sprite would be drawn
         int x = e->x - sprite->nHotx + layer->x - xw;
         int y = e->y - sprite->nHoty + layer->y - yw;
 
         if (x + width > 0 && y + height > 0 &&
-            x < res.x     && y < res.y      &&
-            e->isVisible
+            x < res.x     && y < res.y
         ) {
-            drawlist.push_back(e);                                                          // the entity is onscreen, tag it.
-        }
-    }
-
-    if (!drawlist.empty()) {
-        // Sort them by y value. (see the CompareEntity functor above)
-        std::sort(drawlist.begin(), drawlist.end(), CompareEntities());
-
-        video->SetBlendMode(Video::Normal);
-        for (std::vector<Entity*>::iterator j = drawlist.begin(); j != drawlist.end(); j++) {
-#if 0
-            const Entity* e = *j;
-            const Sprite* s = e->sprite;
-            int x = e->x - xwin - s->nHotx + layer->x;
-            int y = e->y - ywin - s->nHoty + layer->y;
-
-            DrawEntity(e, x, y);
-#else
-            RenderEntity(*j);
-#endif
+            RenderEntity(e);
         }
     }
 }
 
-void Engine::RenderLayer(uint layerIndex) {
-    CDEBUG("renderlayer");
-
-    int lenX, lenY;          // x/y run length
-    int firstX, firstY;      // x/y start
-    int adjustX, adjustY;    // sub-tile offset
+bool Engine::GetLayerWindow(uint layerIndex, LayerWindow& w) {
     const Map::Layer* layer = map.GetLayer(layerIndex);
 
-    int xw = (xwin * layer->parallax.mulx / layer->parallax.divx) - layer->x;
-    int yw = (ywin * layer->parallax.muly / layer->parallax.divy) - layer->y;
+    w.xw = (xwin * layer->parallax.mulx / layer->parallax.divx) - layer->x;
+    w.yw = (ywin * layer->parallax.muly / layer->parallax.divy) - layer->y;
 
-    adjustX = xw % tiles->Width();
-    adjustY = yw % tiles->Height();
+    w.adjustX = w.xw % tiles->Width();
+    w.adjustY = w.yw % tiles->Height();
 
-    firstX = xw / tiles->Width();
-    firstY = yw / tiles->Height();
+    w.firstX = w.xw / tiles->Width();
+    w.firstY = w.yw / tiles->Height();
 
-	if (xw < 0 && layer->wrapx) firstX -= 1;
-	if (yw < 0 && layer->wrapy) firstY -= 1;
+	if (w.xw < 0 && layer->wrapx) w.firstX -= 1;
+	if (w.yw < 0 && layer->wrapy) w.firstY -= 1;
 
     const Point res = video->GetResolution();
-    lenX = res.x / tiles->Width() + 1;
-    lenY = res.y / tiles->Height() + 2;
+    w.lenX = res.x / tiles->Width() + 1;
+    w.lenY = res.y / tiles->Height() + 2;
 
-    if (firstX < 0) {
+    if (w.firstX < 0) {
 		if (layer->wrapx) {
-			lenX += 1;
-			firstX = layer->Width() + firstX - 1;
-			adjustX += tiles->Width() * 2;
+			w.lenX += 1;
+			w.firstX = layer->Width() + w.firstX - 1;
+			w.adjustX += tiles->Width() * 2;
 		}
 		else {
-			lenX -= -firstX;
-			adjustX += firstX * tiles->Width();
-			firstX = 0;
+			w.lenX -= -w.firstX;
+			w.adjustX += w.firstX * tiles->Width();
+			w.firstX = 0;
 		}
     }
 
-    if (firstY < 0) {
+    if (w.firstY < 0) {
 		if (layer->wrapy) {
-			lenY += 1;
-			firstY = layer->Height() + firstY - 1;
-			adjustY += tiles->Height() * 2;
+			w.lenY += 1;
+			w.firstY = layer->Height() + w.firstY - 1;
+			w.adjustY += tiles->Height() * 2;
 		}
 		else {
-	        lenY -= -firstY;
-			adjustY += firstY * tiles->Height();
-			firstY = 0;
+	        w.lenY -= -w.firstY;
+			w.adjustY += w.firstY * tiles->Height();
+			w.firstY = 0;
 		}
     }
 
     if (!layer->wrapx) {
-        if (firstX + lenX > layer->Width()) {
-            lenX = layer->Width() - firstX;
+        if (w.firstX + w.lenX > layer->Width()) {
+            w.lenX = layer->Width() - w.firstX;
         }
     }
 
     if (!layer->wrapy) {
-        if (firstY + lenY > layer->Height()) {
-            lenY = layer->Height() - firstY;
+        if (w.firstY + w.lenY > layer->Height()) {
+            w.lenY = layer->Height() - w.firstY;
         }
     }
 
-    if (lenX < 1 || lenY < 1) return;   // not visible
+    return w.lenX > 0 && w.lenY > 0;
+}
 
-    const uint*  t = layer->tiles.GetPointer(firstX, firstY);
-    int xinc = layer->Width() - lenX;
+void Engine::RenderLayer(uint layerIndex) {
+    CDEBUG("renderlayer");
+    FrameStats::Scope phase(frameStats, FrameStats::layers);
+
+    const Map::Layer* layer = map.GetLayer(layerIndex);
 
-    int curx = -adjustX;
-    int cury = -adjustY;
+    LayerWindow w;
+    if (!GetLayerWindow(layerIndex, w)) return;   // not visible
+
+    const uint*  t = layer->tiles.GetPointer(w.firstX, w.firstY);
+    int xinc = layer->Width() - w.lenX;
+
+    int curx = -w.adjustX;
+    int cury = -w.adjustY;
 
     RGBA oldTint = video->GetTint();
     video->SetTint(layer->tintColour);
     video->SetBlendMode(Video::Normal);
 
-    for (int y = 0; y < lenY; y++) {
-        for (int x = 0; x < lenX; x++) {
+    for (int y = 0; y < w.lenY; y++) {
+        for (int x = 0; x < w.lenX; x++) {
             if (layer->wrapx || layer->wrapy) {
-                t = layer->tiles.GetPointer((firstX + x) % layer->Width(), (firstY + y) % layer->Height());
+                t = layer->tiles.GetPointer((w.firstX + x) % layer->Width(), (w.firstY + y) % layer->Height());
             }
 
             video->BlitImage(tiles->GetTile(*t), curx, cury);
@@ -569,17 +788,163 @@ void Engine::RenderLayer(uint layerIndex) {
             t++;
         }
         cury += tiles->Height();
-        curx = -adjustX;
+        curx = -w.adjustX;
         t += xinc;
     }
 
     video->SetTint(oldTint);
 }
 
+void Engine::FindDamage(const std::vector<uint>& list) {
+    const Point res = video->GetResolution();
+    _damage.SetBounds(Rect(0, 0, res.x, res.y));
+
+    // Script hooks and render scripts can draw anything, anywhere.
+    bool full = !_screenValid || tiles != _drawnTiles || _hookRetrace.begin() != _hookRetrace.end();
+
+    if (_layerEntitiesDirty) {
+        RebuildLayerEntities();
+    }
+
+    // Layers: anything that moves the whole layer means redrawing everything.  Otherwise, just
+    // the tiles that were changed, or whose animation moved on a frame.
+    std::vector<DrawnLayer> layers(list.size());
+    const std::vector<uint>& changed = tiles->ChangedTiles();
+    std::vector<bool> isChanged(changed.empty() ? 0 : tiles->NumTiles());
+    for (uint i = 0; i < changed.size(); i++) {
+        isChanged[changed[i]] = true;
+    }
+
+    full = full || layers.size() != _drawnLayers.size();
+
+    for (uint i = 0; i < list.size(); i++) {
+        DrawnLayer& drawn = layers[i];
+        drawn.index = list[i];
+        drawn.visible = list[i] < map.NumLayers() && GetLayerWindow(list[i], drawn.window);
+        if (!drawn.visible) {
+            continue;
+        }
+
+        const Map::Layer* layer = map.GetLayer(list[i]);
+        drawn.tint = layer->tintColour;
+        drawn.tiles.reserve(drawn.window.lenX * drawn.window.lenY);
+        for (int y = 0; y < drawn.window.lenY; y++) {
+            for (int x = 0; x < drawn.window.lenX; x++) {
+                drawn.tiles.push_back(layer->tiles((drawn.window.firstX + x) % layer->Width(), (drawn.window.firstY + y) % layer->Height()));
+            }
+        }
+
+        if (full) {
+            continue;
+        }
+
+        const DrawnLayer& old = _drawnLayers[i];
+        if (!(old == drawn)) {
+            full = true;
+            continue;
+        }
+
+        for (int y = 0; y < drawn.window.lenY; y++) {
+            for (int x = 0; x < drawn.window.lenX; x++) {
+                const uint j = y * drawn.window.lenX + x;
+                const uint t = drawn.tiles[j];
+                if (t != old.tiles[j] || (t < isChanged.size() && isChanged[t])) {
+                    const int tx = x * tiles->Width() - drawn.window.adjustX;
+                    const int ty = y * tiles->Height() - drawn.window.adjustY;
+                    _damage.Add(Rect(tx, ty, tx + tiles->Width(), ty + tiles->Height()));
+                }
+            }
+        }
+    }
+
+    // Entities: wherever one was last frame, and wherever it is now, if it moved or changed frames.
+    // They're all recorded even when the whole screen is being redrawn, so that next frame has something to compare with.
+    std::vector<DrawnEntity> entities;
+    for (uint i = 0; i < list.size(); i++) {
+        if (list[i] >= _layerEntities.size()) {
+            continue;
+        }
+
+        const EntityVector& layerEntities = _layerEntities[list[i]];
+        const Map::Layer* layer = map.GetLayer(list[i]);
+        const int xw = (xwin * layer->parallax.mulx / layer->parallax.divx) - layer->x;
+        const int yw = (ywin * layer->parallax.muly / layer->parallax.divy) - layer->y;
+
+        for (uint j = 0; j < layerEntities.size(); j++) {
+            const Entity* e = layerEntities[j];
+            const Sprite* sprite = e->sprite;
+            if (!sprite || !e->isVisible) {
+                continue;
+            }
+            if (e->renderScript.get()) {
+                full = true;
+            }
+
+            DrawnEntity drawn;
+            drawn.entity = e;
+            drawn.sprite = sprite;
+            drawn.frame = (e->specFrame != -1) ? e->specFrame : e->curFrame;
+
+            const int x = e->x - sprite->nHotx + layer->x - xw;
+            const int y = e->y - sprite->nHoty + layer->y - yw;
+            drawn.rect = Rect(x, y, x + sprite->Width(), y + sprite->Height());
+
+            entities.push_back(drawn);
+        }
+    }
+
+    if (!full) {
+        std::sort(entities.begin(), entities.end());
+
+        // Both lists are sorted by entity, so walk them together.
+        std::vector<DrawnEntity>::const_iterator a = _drawnEntities.begin();
+        std::vector<DrawnEntity>::const_iterator b = entities.begin();
+        while (a != _drawnEntities.end() || b != entities.end()) {
+            if (b == entities.end() || (a != _drawnEntities.end() && a->entity < b->entity)) {
+                _damage.Add(a->rect);                       // gone
+                a++;
+            } else if (a == _drawnEntities.end() || b->entity < a->entity) {
+                _damage.Add(b->rect);                       // new
+                b++;
+            } else {
+                if (!(*a == *b)) {
+                    _damage.Add(a->rect);
+                    _damage.Add(b->rect);
+                }
+                a++;
+                b++;
+            }
+        }
+    }
+
+    if (full) {
+        _damage.AddAll();
+    }
+
+    _drawnLayers.swap(layers);
+    _drawnEntities.swap(entities);
+    _drawnTiles = tiles;
+    _screenValid = true;
+}
+
+void Engine::InvalidateScreen() {
+    _screenValid = false;
+}
+
 void Engine::Render() {
     Render(renderList);
 }
 
+void Engine::RenderLayers(const std::vector<uint>& list) {
+    for (uint i = 0; i < list.size(); i++) {
+        uint j = list[i];
+        if (j < map.NumLayers()) {
+            RenderLayer(j);
+            RenderEntities(j);
+        }
+    }
+}
+
 void Engine::Render(const std::vector<uint>& list) {
     CDEBUG("render");
     const Point res = video->GetResolution();
@@ -588,6 +953,8 @@ void Engine::Render(const std::vector<uint>& list) {
         return;
     }
 
+    const double startTime = GetPreciseTime();
+
     tiles->UpdateAnimation(GetTime());
 
     if (cameraTarget) {
@@ -600,15 +967,98 @@ void Engine::Render(const std::vector<uint>& list) {
 
     // Note that we do not clear the screen here.  This is intentional.
 
-    for (uint i = 0; i < list.size(); i++) {
-        uint j = list[i];
-        if (j < map.NumLayers()) {
-            RenderLayer(j);
-            RenderEntities(j);
+    if (!video->RetainsScreen()) {
+        RenderLayers(list);
+    } else {
+        // Only redraw what changed since last frame.
+        FindDamage(list);
+        video->SetDirtyRegion(_damage.Rects());
+
+        if (_damage.IsFull()) {
+            RenderLayers(list);
+        } else if (!_damage.IsEmpty()) {
+            ScopedPtr<Rect> oldClip(video->GetClipRect());
+            const std::vector<Rect>& rects = _damage.Rects();
+            for (uint i = 0; i < rects.size(); i++) {
+                // Stay inside whatever the script clipped to.
+                const Rect r(
+                    max(rects[i].left, oldClip->left), max(rects[i].top, oldClip->top),
+                    min(rects[i].right, oldClip->right), min(rects[i].bottom, oldClip->bottom));
+                if (r.Width() <= 0 || r.Height() <= 0) {
+                    continue;
+                }
+
+                video->ClipScreen(r.left, r.top, r.right, r.bottom);
+                RenderLayers(list);
+            }
+            video->ClipScreen(oldClip->left, oldClip->top, oldClip->right, oldClip->bottom);
+        }
+    }
+
+    {
+        FrameStats::Scope phase(frameStats, FrameStats::hooks);
+        DoHook(_hookRetrace);
+    }
+
+    _renderTime += GetPreciseTime() - startTime;
+    _renderCount++;
+}
+
+void Engine::ShowPage() {
+    {
+        FrameStats::Scope phase(frameStats, FrameStats::showPage);
+
+        if (_showFrameStats && _overlayFont) {
+            frameStats.Draw(video, _overlayFont.get(), 0, 0);
         }
+
+        video->ShowPage();
     }
 
-    DoHook(_hookRetrace);
+    DeliverGrabs();
+    frameStats.EndFrame();
+}
+
+void Engine::GrabCanvasAsync(int x1, int y1, int x2, int y2, const ScriptObject& callback) {
+    PendingGrab grab;
+    grab.ticket = video->BeginGrabCanvas(x1, y1, x2, y2);
+    grab.callback = callback;
+    _grabs.push_back(grab);
+}
+
+void Engine::SaveScreenshot(const std::string& fileName) {
+    const Point res = video->GetResolution();
+
+    PendingGrab grab;
+    grab.ticket = video->BeginGrabCanvas(0, 0, res.x, res.y);
+    grab.fileName = fileName;
+    _grabs.push_back(grab);
+}
+
+void Engine::DeliverGrabs() {
+    // Take the finished ones out of the list first.  Callbacks are free to start more grabs.
+    std::vector<PendingGrab> ready;
+    std::vector<Canvas*> canvases;
+
+    for (uint i = 0; i < _grabs.size(); ) {
+        Canvas* c = video->FinishGrabCanvas(_grabs[i].ticket, false);
+        if (!c) {
+            i++;
+            continue;
+        }
+
+        ready.push_back(_grabs[i]);
+        canvases.push_back(c);
+        _grabs.erase(_grabs.begin() + i);
+    }
+
+    for (uint i = 0; i < ready.size(); i++) {
+        if (!ready[i].fileName.empty()) {
+            Parallel::Background(new SaveCanvasTask(canvases[i], ready[i].fileName));
+        } else {
+            script.ExecObject(ready[i].callback, canvases[i]);
+        }
+    }
 }
 
 void Engine::DoHook(HookList& hooklist) {
@@ -632,7 +1082,15 @@ void Engine::DoHook(HookList& hooklist) {
 
 void Engine::GameTick() {
     CDEBUG("gametick");
+    FrameStats::Scope phase(frameStats, FrameStats::tick);
 
+    if (_tickLimit != 0 && _tickCount >= _tickLimit) {
+        Log::Write("Reached %i ticks.  Stopping.", _tickLimit);
+        Shutdown();
+        exit(0);
+    }
+
+    _tickCount++;
     CheckKeyBindings();
     DoHook(_hookTimer);
     ProcessEntities();
@@ -813,6 +1271,7 @@ Entity* Engine::SpawnEntity() {
     Entity* e = new Entity(this);
 
     entities.push_back(e);
+    InvalidateLayerEntities();
 
     return e;
 }
@@ -840,6 +1299,7 @@ void Engine::DestroyEntity(Entity* e) {
 
     // actually nuke it
     entities.remove(e);
+    InvalidateLayerEntities();
     delete e;
 }
 
@@ -876,6 +1336,8 @@ void Engine::LoadMap(const std::string& filename) {
             tiles = new Tileset(mapPath + map.tilesetName, video);               // load up them tiles
         }
 
+        InvalidateScreen();
+
         script.ClearEntityList();
 
         std::map<const Map::Entity*, Entity*> entMap;                   // used so we know which is related to which, so we can properly gather objects from the map script. (once it's loaded)
@@ -897,6 +1359,7 @@ void Engine::LoadMap(const std::string& filename) {
 
         xwin = ywin = 0;                                                // just in case
         _isMapLoaded = true;
+        InvalidateLayerEntities();
 
         if (!script.LoadMapScripts(mapName)) {
             Script_Error();
@@ -923,6 +1386,7 @@ void Engine::LoadMap(const std::string& filename) {
             }
         }
 
+        MemStats::Log();
         SyncTime();
     } catch (std::runtime_error err) {   
         Sys_Error(va("LoadMap(\"%s\"): %s", filename.c_str(), err.what())); 
@@ -968,6 +1432,15 @@ Engine::Engine()
     , player(0)
     , xwin(0)
     , ywin(0)
+    , _tickCount(0)
+    , _tickLimit(0)
+    , _headless(false)
+    , _startTime(0)
+    , _renderTime(0)
+    , _renderCount(0)
+    , _layerEntitiesDirty(true)
+    , _screenValid(false)
+    , _drawnTiles(0)
     , cameraTarget(0)
     , _isMapLoaded(false)
     , _recurseStop(false) {}
@@ -979,16 +1452,41 @@ int main(int argc, char* argv[]) {
      * Some launchers programs simply refuse you to use escape characters :/. 
      */  
     std::string pathname;
-    if(argc > 1) {
-        pathname = argv[1];
-        for (int i = 2; i < argc; i++) {      
-            pathname = pathname + " " + argv[i];
+    EngineOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        // --record file and --replay file save and play back input.  See journal.h
+        // --benchmark file runs the benchmarks instead of the game.  See benchmark.h
+        // --headless runs without a display, as fast as possible.  --ticks n stops after n ticks.
+        // --trace file records what the engine spends its time on.  See common/trace.h
+        // --map file starts on that map, whichever one the game's scripts pick.  (for running every map headless)
+        if (arg == "--record" && i + 1 < argc) {
+            options.recordName = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            options.replayName = argv[++i];
+        } else if (arg == "--benchmark" && i + 1 < argc) {
+            options.benchmarkName = argv[++i];
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            options.tickLimit = (uint)std::atoi(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.traceName = argv[++i];
+        } else if (arg == "--map" && i + 1 < argc) {
+            options.mapName = argv[++i];
+        } else if (pathname.empty()) {
+            pathname = arg;
+        } else {
+            pathname = pathname + " " + arg;
         }
     }
-    
+
+    // Start now, so that startup gets traced too.
+    Trace::Enable(!options.traceName.empty());
 
     Engine engine;
-    engine.Startup(pathname);
+    engine.Startup(pathname, options);
     engine.MainLoop();
     engine.Shutdown();
 
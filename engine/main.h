@@ -17,6 +17,7 @@
 #include "common/utility.h"
 #include "common/types.h"
 #include "video/Driver.h"
+#include "dirtyregion.h"
 #include "hooklist.h"
 #include "path.h"
 
@@ -29,7 +30,25 @@
 #include "sprite.h"
 #include "entity.h"
 #include "font.h"
-
+#include "framestats.h"
+#include "journal.h"
+
+
+/// Things that can be set from the command line.
+struct EngineOptions {
+    std::string recordName;                                                         ///< --record: file to write an input journal to
+    std::string replayName;                                                         ///< --replay: input journal to play back
+    std::string benchmarkName;                                                      ///< --benchmark: run the benchmarks and write the results here
+    bool headless;                                                                  ///< --headless: no window, no sound, and time runs as fast as it can
+    uint tickLimit;                                                                 ///< --ticks: quit after this many ticks (0 means never)
+    std::string traceName;                                                          ///< --trace: record a trace, and write it here on shutdown
+    std::string mapName;                                                            ///< --map: map to switch to once the system scripts are loaded, instead of the one they picked
+
+    EngineOptions()
+        : headless(false)
+        , tickLimit(0)
+    {}
+};
 
 /**
  *  Main module thingie.
@@ -43,6 +62,7 @@ struct Engine {
     friend struct ScriptEngine;
 
     typedef std::list<Entity*>      EntityList;
+    typedef std::vector<Entity*>    EntityVector;
     
 public:                                                                             // Too many components need access to this class.  
     
@@ -55,15 +75,93 @@ public:
 
     Video::Driver*                  video;
 
+    InputJournal                    journal;                                        ///< input recording/playback
+    FrameStats                      frameStats;                                     ///< how long recent frames took
+
 	Entity*                         player;                                         ///< Points to the current player entity
 	
 
     bool                            _showFramerate;                                 ///< The current framerate is printed in the upper left corner of the screen if true.
+    bool                            _showFrameStats;                                ///< Frame timings are drawn over everything if true.
    
     
 private:
     int                             xwin, ywin;                                     ///< world coordinates of the viewport
     int                             _oldTime;                                       ///< used for framerate regulation
+    uint                            _tickCount;                                     ///< number of times GameTick has been called
+    uint                            _tickLimit;                                     ///< if nonzero, the engine quits after this many ticks
+
+    bool                            _headless;                                      ///< true if running without a display
+    double                          _startTime;                                     ///< when the game started running, for the headless summary
+    double                          _renderTime;                                    ///< seconds spent in Render
+    ScopedPtr<Ika::Font>            _overlayFont;                                   ///< font the frame stats are drawn in
+    uint                            _renderCount;                                   ///< number of times Render has been called
+    std::string                     _traceName;                                     ///< where the trace goes on shutdown, if we're tracing
+
+    std::vector<EntityVector>       _layerEntities;                                 ///< Entities on each layer, kept sorted by y for rendering.
+    bool                            _layerEntitiesDirty;                            ///< true if _layerEntities must be rebuilt before it can be used
+
+    /// The part of a layer that's on the screen, in tiles, and how far the first tile hangs off the top left.
+    struct LayerWindow {
+        int xw, yw;                                                                 ///< where the layer's origin is, relative to the screen
+        int firstX, firstY;
+        int lenX, lenY;
+        int adjustX, adjustY;
+
+        bool operator == (const LayerWindow& w) const {
+            return xw == w.xw && yw == w.yw && firstX == w.firstX && firstY == w.firstY &&
+                lenX == w.lenX && lenY == w.lenY && adjustX == w.adjustX && adjustY == w.adjustY;
+        }
+    };
+
+    /// A layer as it was last drawn, for working out what changed.
+    struct DrawnLayer {
+        uint index;
+        bool visible;
+        LayerWindow window;
+        RGBA tint;
+        std::vector<uint> tiles;                                                    ///< the ones on screen, row by row
+
+        bool operator == (const DrawnLayer& l) const {                            ///< Same place and tint.  The tiles are compared separately.
+            return index == l.index && visible == l.visible && (!visible || (window == l.window && tint == l.tint));
+        }
+    };
+
+    /// An entity as it was last drawn.
+    struct DrawnEntity {
+        const Entity* entity;
+        const Sprite* sprite;
+        uint frame;
+        Rect rect;                                                                  ///< on screen
+
+        bool operator < (const DrawnEntity& e) const { return entity < e.entity; }
+        bool operator == (const DrawnEntity& e) const {
+            return entity == e.entity && sprite == e.sprite && frame == e.frame &&
+                rect.left == e.rect.left && rect.top == e.rect.top && rect.right == e.rect.right && rect.bottom == e.rect.bottom;
+        }
+    };
+
+    // Dirty rectangles, for video drivers that keep the screen between frames.
+    DirtyRegion                     _damage;                                        ///< what this frame has to redraw
+    bool                            _screenValid;                                   ///< false if the whole screen has to be redrawn next frame
+    const Tileset*                  _drawnTiles;                                    ///< the tileset last frame was drawn with
+    std::vector<DrawnLayer>         _drawnLayers;                                   ///< last frame's layers, in the order drawn
+    std::vector<DrawnEntity>        _drawnEntities;                                 ///< last frame's entities, sorted by address
+
+    bool      GetLayerWindow(uint layerIndex, LayerWindow& w);                      ///< Returns false if none of the layer is on screen.
+    void      FindDamage(const std::vector<uint>& list);                            ///< Works out _damage by comparing this frame with the last.
+    void      RenderLayers(const std::vector<uint>& list);                          ///< Draws the layers and their entities.
+
+    /// A screen grab the video driver is still working on.  The canvas goes to callback, or is saved as fileName.
+    struct PendingGrab {
+        uint ticket;
+        ScriptObject callback;
+        std::string fileName;
+    };
+
+    std::vector<PendingGrab>        _grabs;
+
+    void      DeliverGrabs();                                                       ///< Hands over the grabs that have finished.  Called once a frame.
 
 public:
     Entity*                         cameraTarget;                                   ///< Points to the current camera target
@@ -84,6 +182,7 @@ public:
     void      Script_Error();                                                       ///< also complains and quits
     void      Script_Error(std::string msg);
     void      CheckMessages();                                                      ///< Play nice with Mr. Gates (or Torvalds, or Jobs, or...)
+    void      HandleEvent(const SDL_Event& event);                                  ///< Passes an input event along to whatever wants it
     
     void      GameTick();                                                           ///< 1/100th of a second's worth of AI
     void      CheckKeyBindings();                                                   ///< checks to see if any bound keys are pressed
@@ -102,6 +201,8 @@ public:
 
     Entity*   SpawnEntity();                                                        ///< Creates an entity, and returns it
     void      DestroyEntity(Entity* e);                                             ///< Annihilates the entity
+    void      InvalidateLayerEntities();                                            ///< Call when an entity is created, destroyed, or changes layers.
+    void      RebuildLayerEntities();                                               ///< Sorts every entity into the per-layer render lists.
 
     void      RenderEntity(const Entity* ent);                                      ///< Renders an entity
     void      DrawEntity(const Entity* ent);                                        ///< Default way to render an entity (current frame, at x,y taking xwin/ywin into account etc etc)
@@ -110,12 +211,18 @@ public:
     void      RenderLayer(uint layerIndex);                                         ///< renders a single layer
     void      Render();                                                             ///< renders everything
     void      Render(const std::vector<uint>& list);                                ///< Renders the layers specified, in order.
+    void      ShowPage();                                                           ///< Draws any overlays, flips the page, and ends the frame.
+    void      InvalidateScreen();                                                   ///< Makes the next Render redraw everything, for changes it can't see for itself.
+
+    /// Grabs part of the screen without waiting for the video card.  callback gets the canvas a frame or two later.
+    void      GrabCanvasAsync(int x1, int y1, int x2, int y2, const ScriptObject& callback);
+    void      SaveScreenshot(const std::string& fileName);                          ///< Grabs the whole screen the same way, and writes it out as a PNG on a background thread.
     
     void      LoadMap(const std::string& filename);                                 ///< switches maps
     
     void      DoHook(HookList& hooklist);                                           ///< Calls every function in the list, then flushes any pending adds/removals from said list
 
-    void      Startup(std::string& pathname);                                       ///< Inits the engine
+    void      Startup(std::string& pathname, const EngineOptions& options = EngineOptions()); ///< Inits the engine
     void      Shutdown();                                                           ///< deinits the engine
     void      MainLoop();                                                           ///< runs the engine
 
@@ -0,0 +1,132 @@
+#include "maprender.h"
+#include "tileset.h"
+
+#include "common/Canvas.h"
+#include "common/log.h"
+#include "common/thread.h"
+
+namespace {
+    const int bandPixels = 64;      // Rows of full size pixels in each band.  Small enough to share the work out evenly.
+
+    /// Alpha blending, with the colour multiplied by the layer tint first.  Same as the video drivers do.
+    struct TintBlend {
+        TintBlend(RGBA t) : tint(t) {}
+
+        inline RGBA operator()(RGBA src, RGBA dest) const {
+            src.r = u8(src.r * tint.r / 255);
+            src.g = u8(src.g * tint.g / 255);
+            src.b = u8(src.b * tint.b / 255);
+            src.a = u8(src.a * tint.a / 255);
+            return alphaBlend(src, dest);
+        }
+
+        RGBA tint;
+        Blitter::AlphaBlend alphaBlend;
+    };
+
+    struct RenderBand : Parallel::Task {
+        const Tileset& tiles;
+        const std::vector<const Map::Layer*>& layers;
+        const Rect area;
+        const int scale;
+        const int bandHeight;                               // in rows of dest
+        Canvas& dest;
+
+        RenderBand(const Tileset& t, const std::vector<const Map::Layer*>& l, const Rect& a, int s, int h, Canvas& d)
+            : tiles(t)
+            , layers(l)
+            , area(a)
+            , scale(s)
+            , bandHeight(h)
+            , dest(d)
+        {}
+
+        virtual void Run(uint index) {
+            const int tileWidth = tiles.Width();
+            const int tileHeight = tiles.Height();
+            const int srcWidth = area.Width() * tileWidth;
+            const int srcHeight = area.Height() * tileHeight;
+
+            const int top = index * bandHeight;
+            const int bottom = min(dest.Height(), top + bandHeight);
+            const int srcTop = top * scale;
+            const int srcBottom = min(srcHeight, bottom * scale);
+
+            // Draw the band full size, then copy or shrink it into place.
+            Canvas band(srcWidth, srcBottom - srcTop);
+
+            const int firstRow = area.top + srcTop / tileHeight;
+            const int lastRow = area.top + (srcBottom - 1) / tileHeight;
+
+            for (uint l = 0; l < layers.size(); l++) {
+                const Map::Layer* layer = layers[l];
+                const TintBlend blend(layer->tintColour);
+
+                for (int ty = max(firstRow, 0); ty <= lastRow && ty < layer->Height(); ty++) {
+                    const int y = (ty - area.top) * tileHeight - srcTop;
+                    for (int tx = max(area.left, 0); tx < area.right && tx < layer->Width(); tx++) {
+                        const int x = (tx - area.left) * tileWidth;
+                        Blitter::Blit(tiles.GetTileCanvas(layer->tiles(tx, ty)), band, x, y, blend);
+                    }
+                }
+            }
+
+            if (scale == 1) {
+                for (int y = top; y < bottom; y++) {
+                    const RGBA* src = band.GetPixels() + (y - top) * srcWidth;
+                    std::copy(src, src + srcWidth, dest.GetPixels() + y * dest.Width());
+                }
+                return;
+            }
+
+            for (int y = top; y < bottom; y++) {
+                RGBA* out = dest.GetPixels() + y * dest.Width();
+                const int y1 = y * scale - srcTop;
+                const int y2 = min(y1 + scale, band.Height());
+
+                for (int x = 0; x < dest.Width(); x++) {
+                    const int x1 = x * scale;
+                    const int x2 = min(x1 + scale, srcWidth);
+
+                    // Blocks on the right and bottom edges can be partly outside the source.
+                    uint r = 0, g = 0, b = 0, a = 0;
+                    for (int sy = y1; sy < y2; sy++) {
+                        const RGBA* p = band.GetPixels() + sy * srcWidth + x1;
+                        for (int sx = x1; sx < x2; sx++, p++) {
+                            r += p->r;  g += p->g;  b += p->b;  a += p->a;
+                        }
+                    }
+
+                    const uint count = (y2 - y1) * (x2 - x1);
+                    *out++ = RGBA(r / count, g / count, b / count, a / count);
+                }
+            }
+        }
+    };
+}
+
+Canvas* RenderMapToCanvas(Map& map, const Tileset& tiles, const std::vector<uint>& layerIndices, const Rect& area, int scale) {
+    CDEBUG("RenderMapToCanvas");
+
+    const int srcWidth = area.Width() * tiles.Width();
+    const int srcHeight = area.Height() * tiles.Height();
+    Canvas* dest = new Canvas(max(1, (srcWidth + scale - 1) / scale), max(1, (srcHeight + scale - 1) / scale));
+
+    if (srcWidth < 1 || srcHeight < 1 || tiles.NumTiles() == 0) {
+        return dest;
+    }
+
+    std::vector<const Map::Layer*> layers;
+    for (uint i = 0; i < layerIndices.size(); i++) {
+        layers.push_back(map.GetLayer(layerIndices[i]));
+    }
+
+    // The tileset packs its tiles the first time they're asked for.  Get that over with here, rather than in several threads at once.
+    tiles.GetTileCanvas(0);
+
+    const int bandHeight = max(1, bandPixels / scale);
+    RenderBand task(tiles, layers, area, scale, bandHeight, *dest);
+    Parallel::For(task, (dest->Height() + bandHeight - 1) / bandHeight);
+
+    return dest;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+#include "common/map.h"
+
+struct Canvas;
+struct Tileset;
+
+/**
+ *  Draws tile layers straight onto a new canvas, without going through the
+ *  video driver.  For minimaps and map snapshots.
+ *
+ *  The layers are drawn in the order given, each with its tint, at their tile
+ *  positions (parallax and layer offsets don't apply).  area is in tiles.  If
+ *  scale is more than 1, each scale x scale block of pixels is averaged into
+ *  one pixel of the result.  Bands of rows are drawn in parallel.
+ */
+Canvas* RenderMapToCanvas(Map& map, const Tileset& tiles, const std::vector<uint>& layers, const Rect& area, int scale);
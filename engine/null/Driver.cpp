@@ -0,0 +1,111 @@
+#include <cstdlib>
+
+#include "Driver.h"
+
+#include "utility.h"
+
+namespace Null {
+
+    Driver::Driver(int xres, int yres)
+        : _xres(xres)
+        , _yres(yres)
+        , _tint(RGBA(255, 255, 255))
+        , _clipRect(0, 0, xres, yres)
+        , _blendMode(Video::Normal)
+        , _nextGrab(0)
+    {}
+
+    Driver::~Driver() {
+        for (std::map<uint, Canvas*>::iterator iter = _grabs.begin(); iter != _grabs.end(); iter++) {
+            delete iter->second;
+        }
+    }
+
+    bool Driver::SwitchResolution(int x, int y) {
+        _xres = x;
+        _yres = y;
+        _clipRect = Rect(0, 0, x, y);
+        return true;
+    }
+
+    Video::Image* Driver::CreateImage(Canvas& src) {
+        return new Image(src.Width(), src.Height());
+    }
+
+    Video::Image* Driver::CreateSubImage(Video::Image* img, int x, int y, int w, int h) {
+        x = max(0, min(x, img->Width()));
+        y = max(0, min(y, img->Height()));
+        return new Image(max(0, min(w, img->Width() - x)), max(0, min(h, img->Height() - y)));
+    }
+
+    void Driver::FreeImage(Video::Image* img) {
+        _renderTargets.erase(img);
+        delete static_cast<Image*>(img);
+    }
+
+    Video::Image* Driver::CreateRenderTarget(int width, int height) {
+        Image* img = new Image(width, height);
+        _renderTargets.insert(img);
+        return img;
+    }
+
+    bool Driver::RenderTo(Video::Image* img) {
+        return !img || _renderTargets.count(img) != 0;
+    }
+
+    void Driver::ClipScreen(int left, int top, int right, int bottom) {
+        if (left > right) {
+            swap(left, right);
+        }
+        if (top > bottom) {
+            swap(top, bottom);
+        }
+        _clipRect = Rect(left, top, right, bottom);
+    }
+
+    Rect* Driver::GetClipRect() {
+        return new Rect(_clipRect);
+    }
+
+    void Driver::ShowPage() {
+        fps.Update();
+    }
+
+    Video::BlendMode Driver::SetBlendMode(Video::BlendMode bm) {
+        Video::BlendMode old = _blendMode;
+        _blendMode = bm;
+        return old;
+    }
+
+    Video::Image* Driver::GrabImage(int x1, int y1, int x2, int y2) {
+        return new Image(abs(x2 - x1), abs(y2 - y1));
+    }
+
+    Canvas* Driver::GrabCanvas(int x1, int y1, int x2, int y2) {
+        return new Canvas(abs(x2 - x1), abs(y2 - y1));
+    }
+
+    uint Driver::BeginGrabCanvas(int x1, int y1, int x2, int y2) {
+        _grabs[++_nextGrab] = GrabCanvas(x1, y1, x2, y2);
+        return _nextGrab;
+    }
+
+    Canvas* Driver::FinishGrabCanvas(uint ticket, bool) {
+        std::map<uint, Canvas*>::iterator iter = _grabs.find(ticket);
+        if (iter == _grabs.end()) {
+            return 0;
+        }
+
+        Canvas* c = iter->second;
+        _grabs.erase(iter);
+        return c;
+    }
+
+    Point Driver::GetResolution() const {
+        return Point(_xres, _yres);
+    }
+
+    int Driver::GetFrameRate() const {
+        return fps.FPS();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <map>
+#include <set>
+
+#include "../video/Driver.h"
+#include "../../common/Canvas.h"
+#include "../../common/types.h"
+
+#include "../FPSCounter.h"
+
+/// Video driver that draws nothing, for running the engine without a display.
+namespace Null {
+    struct Driver;
+
+    /// An image with a size, and no pixels.
+    struct Image : Video::Image {
+        friend struct Null::Driver;
+
+        virtual int Width()  { return _width; }
+        virtual int Height() { return _height; }
+
+    private:
+        int _width, _height;
+
+        Image(int width, int height) : _width(width), _height(height) {}
+        ~Image() {}
+    };
+
+    /// The driver itself.  Everything succeeds, and nothing happens.
+    struct Driver : public Video::Driver {
+
+        Driver(int xres, int yres);
+        ~Driver();
+
+        virtual void SwitchToFullScreen() {}
+        virtual void SwitchToWindowed() {}
+        virtual bool SwitchResolution(int x, int y);
+
+        virtual Video::Image* CreateImage(Canvas& pm);
+        virtual Video::Image* CreateSubImage(Video::Image* img, int x, int y, int w, int h);
+        virtual void FreeImage(Video::Image* img);
+        virtual Video::Image* CreateRenderTarget(int width, int height);
+        virtual bool RenderTo(Video::Image* img);
+
+        virtual void ClipScreen(int left, int top, int right, int bottom);
+        virtual Rect* GetClipRect();
+
+        virtual void ShowPage();
+        virtual void ClearScreen() {}
+        virtual bool RetainsScreen() const { return false; }    ///< It would, but headless timings should measure the same full redraw the GL driver does.
+        virtual void SetDirtyRegion(const std::vector<Rect>&) {}
+
+        virtual Video::BlendMode SetBlendMode(Video::BlendMode bm);
+
+        virtual void BlitImage(Video::Image*, int, int) {}
+        virtual void ClipBlitImage(Video::Image*, int, int, int, int, int, int) {}
+        virtual void ScaleBlitImage(Video::Image*, int, int, int, int) {}
+        virtual void RotateBlitImage(Video::Image*, int, int, float, float, float) {}
+        virtual void DistortBlitImage(Video::Image*, int[4], int[4]) {}
+        virtual void TileBlitImage(Video::Image*, int, int, int, int, float, float) {}
+        virtual void TintBlitImage(Video::Image*, int, int, u32) {}
+        virtual void TintDistortBlitImage(Video::Image*, int[4], int[4], u32[4]) {}
+        virtual void TintTileBlitImage(Video::Image*, int, int, int, int, float, float, u32) {}
+
+        virtual void DrawPixel(int, int, u32) {}
+        virtual u32 GetPixel(int, int) { return 0; }
+        virtual void DrawLine(int, int, int, int, u32) {}
+        virtual void DrawRect(int, int, int, int, u32, bool) {}
+        virtual void DrawEllipse(int, int, int, int, u32, bool) {}
+        virtual void DrawArc(int, int, int, int, int, int, int, int, u32, bool) {}
+        virtual void DrawTriangle(int[3], int[3], u32[3]) {}
+        virtual void DrawQuad(int[4], int[4], u32[4]) {}
+        virtual void DrawLineList(std::vector<int>, std::vector<int>, std::vector<u32>, int) {}
+        virtual void DrawTriangleList(std::vector<int>, std::vector<int>, std::vector<u32>, int) {}
+
+        virtual Video::Image* GrabImage(int x1, int y1, int x2, int y2);
+        virtual Canvas* GrabCanvas(int x1, int y1, int x2, int y2);
+        virtual uint BeginGrabCanvas(int x1, int y1, int x2, int y2);
+        virtual Canvas* FinishGrabCanvas(uint ticket, bool wait);
+
+        virtual u32 GetTint()           { return _tint; }
+        virtual void SetTint(u32 tint)  { _tint = tint; }
+
+        virtual Point GetResolution() const;
+        virtual int GetFrameRate() const;
+
+    private:
+        FPSCounter fps;
+        int _xres;
+        int _yres;
+        u32 _tint;
+        Rect _clipRect;
+        Video::BlendMode _blendMode;
+
+        std::set<Video::Image*> _renderTargets;             ///< so RenderTo can turn down other images, as the real drivers do
+        std::map<uint, Canvas*> _grabs;                     ///< grabs that haven't been collected yet.  They're ready straight away.
+        uint _nextGrab;
+    };
+}
@@ -1,5 +1,6 @@
 
 #include <math.h>
+#include <string.h>
 
 #include "SDL/SDL_opengl.h"
 
@@ -23,6 +24,51 @@ namespace OpenGL {
 #ifndef GL_FUNC_ADD_EXT
     const uint GL_FUNC_ADD_EXT = 0x8006;
 #endif
+#ifndef GL_FRAMEBUFFER_EXT
+    const uint GL_FRAMEBUFFER_EXT = 0x8D40;
+#endif
+#ifndef GL_COLOR_ATTACHMENT0_EXT
+    const uint GL_COLOR_ATTACHMENT0_EXT = 0x8CE0;
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE_EXT
+    const uint GL_FRAMEBUFFER_COMPLETE_EXT = 0x8CD5;
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER_ARB
+    const uint GL_PIXEL_PACK_BUFFER_ARB = 0x88EB;
+#endif
+#ifndef GL_STREAM_READ_ARB
+    const uint GL_STREAM_READ_ARB = 0x88E1;
+#endif
+#ifndef GL_READ_ONLY_ARB
+    const uint GL_READ_ONLY_ARB = 0x88B8;
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+    const uint GL_SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+    const uint GL_SYNC_FLUSH_COMMANDS_BIT = 0x00000001;
+#endif
+#ifndef GL_ALREADY_SIGNALED
+    const uint GL_ALREADY_SIGNALED = 0x911A;
+#endif
+#ifndef GL_CONDITION_SATISFIED
+    const uint GL_CONDITION_SATISFIED = 0x911C;
+#endif
+
+    namespace {
+        /// True if the GL_EXTENSIONS string has the whole name in it.
+        bool HasExtension(const char* name) {
+            const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+            const uint length = strlen(name);
+
+            for (const char* p = extensions; p && (p = strstr(p, name)); p += length) {
+                if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == 0)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
 
     Driver::Driver(int xres, int yres, int bpp, bool fullScreen, bool doubleSize, bool filter)
         : _screen(0)
@@ -35,6 +81,9 @@ namespace OpenGL {
         , _doubleSize(doubleSize)
         , _filter(filter)
         , _lasttex(0)
+        , _target(0)
+        , _nextReadback(0)
+        , _frameCount(0)
     {
         if (_doubleSize) {
             xres *= 2;
@@ -59,10 +108,7 @@ namespace OpenGL {
         glMatrixMode(GL_PROJECTION);
         glLoadIdentity();
         glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-        glScalef(2.0f / float(xres), -2.0f / float(yres), 1.0f);
-        glTranslatef(-(float(xres) / 2.0f), -(float(yres) / 2.0f), 0.0f);
-        glViewport(0, 0, xres, yres);
+        SetViewport(xres, yres);
 
         glClearColor(0, 0, 0, 1);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -84,6 +130,41 @@ namespace OpenGL {
             glBlendEquationEXT = &glBlendEquationStub;
         }
 
+        glGenFramebuffersEXT = (void (IKA_STDCALL *)(int, uint*))SDL_GL_GetProcAddress("glGenFramebuffersEXT");
+        glDeleteFramebuffersEXT = (void (IKA_STDCALL *)(int, const uint*))SDL_GL_GetProcAddress("glDeleteFramebuffersEXT");
+        glBindFramebufferEXT = (void (IKA_STDCALL *)(uint, uint))SDL_GL_GetProcAddress("glBindFramebufferEXT");
+        glFramebufferTexture2DEXT = (void (IKA_STDCALL *)(uint, uint, uint, uint, int))SDL_GL_GetProcAddress("glFramebufferTexture2DEXT");
+        glCheckFramebufferStatusEXT = (uint (IKA_STDCALL *)(uint))SDL_GL_GetProcAddress("glCheckFramebufferStatusEXT");
+
+        if (!glGenFramebuffersEXT || !glDeleteFramebuffersEXT || !glBindFramebufferEXT ||
+            !glFramebufferTexture2DEXT || !glCheckFramebufferStatusEXT
+        ) {
+            Log::Write("Warning! EXT_framebuffer_object not found.  Render targets disabled.");
+            glGenFramebuffersEXT = 0;
+        }
+
+        glGenBuffersARB = (void (IKA_STDCALL *)(int, uint*))SDL_GL_GetProcAddress("glGenBuffersARB");
+        glDeleteBuffersARB = (void (IKA_STDCALL *)(int, const uint*))SDL_GL_GetProcAddress("glDeleteBuffersARB");
+        glBindBufferARB = (void (IKA_STDCALL *)(uint, uint))SDL_GL_GetProcAddress("glBindBufferARB");
+        glBufferDataARB = (void (IKA_STDCALL *)(uint, ptrdiff_t, const void*, uint))SDL_GL_GetProcAddress("glBufferDataARB");
+        glMapBufferARB = (void* (IKA_STDCALL *)(uint, uint))SDL_GL_GetProcAddress("glMapBufferARB");
+        glUnmapBufferARB = (u8 (IKA_STDCALL *)(uint))SDL_GL_GetProcAddress("glUnmapBufferARB");
+
+        if (!HasExtension("GL_ARB_pixel_buffer_object") || !glGenBuffersARB || !glDeleteBuffersARB ||
+            !glBindBufferARB || !glBufferDataARB || !glMapBufferARB || !glUnmapBufferARB
+        ) {
+            Log::Write("Warning! ARB_pixel_buffer_object not found.  Screen grabs will wait for the GPU.");
+            glGenBuffersARB = 0;
+        }
+
+        glFenceSync = (void* (IKA_STDCALL *)(uint, uint))SDL_GL_GetProcAddress("glFenceSync");
+        glClientWaitSync = (uint (IKA_STDCALL *)(void*, uint, u64))SDL_GL_GetProcAddress("glClientWaitSync");
+        glDeleteSync = (void (IKA_STDCALL *)(void*))SDL_GL_GetProcAddress("glDeleteSync");
+
+        if (!HasExtension("GL_ARB_sync") || !glFenceSync || !glClientWaitSync || !glDeleteSync) {
+            glFenceSync = 0;
+        }
+
         if (_doubleSize) {
             Log::Write("--Generating doublesize buffer");
             glGenTextures(1, &_bufferTex);
@@ -91,6 +172,11 @@ namespace OpenGL {
     }
 
     Driver::~Driver() {
+        for (std::map<uint, Readback>::iterator iter = _readbacks.begin(); iter != _readbacks.end(); iter++) {
+            FreeReadback(iter->second);
+            delete iter->second.canvas;
+        }
+
         glDeleteTextures(1, &_bufferTex);
     }
 
@@ -117,10 +203,8 @@ namespace OpenGL {
         glMatrixMode(GL_PROJECTION);
         glLoadIdentity();
         glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-        glScalef(2.0f / float(_xres), -2.0f / float(_yres), 1.0f);
-        glTranslatef(-(float(_xres) / 2.0f), -(float(_yres) / 2.0f), 0.0f);
-        glViewport(0, 0, _xres, _yres);
+        RenderTo(0);
+        SetViewport(_xres, _yres);
 
         return true;
     }
@@ -163,7 +247,7 @@ namespace OpenGL {
             if (!tex) {
                 // no texture?  no problem.
                 static u32 dummy[256 * 256] = {0}; // initialized to 0
-                tex = new Texture(0, 256, 256);
+                tex = new Texture(0, 256, 256, 256, 256);
                 glGenTextures(1, &tex->handle);
                 SwitchTexture(tex->handle);
                 glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0, GL_RGBA, GL_UNSIGNED_BYTE, dummy);
@@ -258,12 +342,130 @@ namespace OpenGL {
             }
 
             const float texCoords[] = { 0, 0, float(src.Width()) / texwidth, float(src.Height()) / texheight };
-            Texture* tex = new Texture(texture, texwidth, texheight);
+            Texture* tex = new Texture(texture, texwidth, texheight, src.Width(), src.Height());
             tex->refCount++;
             return new Image(tex, texCoords, src.Width(), src.Height());
         }
     }
 
+    Image* Driver::CreateSubImage(Video::Image* i, int x, int y, int w, int h) {
+        Image* img = static_cast<Image*>(i);
+
+        x = max(0, min(x, img->_width));
+        y = max(0, min(y, img->_height));
+        w = max(0, min(w, img->_width - x));
+        h = max(0, min(h, img->_height - y));
+
+        // The texture is stored upside down, so y runs the other way.
+        const float* tc = img->_texCoords;
+        float cw = (tc[2] - tc[0]) / img->_width;
+        float ch = (tc[3] - tc[1]) / img->_height;
+        const float texCoords[4] = {
+            tc[0] + cw * x,         tc[3] - ch * (y + h),
+            tc[0] + cw * (x + w),   tc[3] - ch * y
+        };
+
+        img->_texture->refCount++;
+        return new Image(img->_texture, texCoords, w, h);
+    }
+
+    Image* Driver::CreateRenderTarget(int width, int height) {
+        if (!glGenFramebuffersEXT || width < 1 || height < 1) {
+            return 0;
+        }
+
+        const int texwidth = nextPowerOf2(width);
+        const int texheight = nextPowerOf2(height);
+
+        uint texture;
+        glGenTextures(1, &texture);
+        SwitchTexture(texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texwidth, texheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        SwitchTexture(0);
+
+        uint framebuffer;
+        glGenFramebuffersEXT(1, &framebuffer);
+        glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, framebuffer);
+        glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, texture, 0);
+
+        const bool ok = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) == GL_FRAMEBUFFER_COMPLETE_EXT;
+        if (ok) {
+            // Start out transparent.  (the scissor box would stop glClear reaching all of it)
+            glPushAttrib(GL_SCISSOR_BIT | GL_COLOR_BUFFER_BIT);
+            glDisable(GL_SCISSOR_TEST);
+            glClearColor(0, 0, 0, 0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glPopAttrib();
+        }
+
+        glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _target ? _target->_texture->framebuffer : 0);
+
+        if (!ok) {
+            Log::Write("Unable to create a %ix%i render target.", width, height);
+            glDeleteFramebuffersEXT(1, &framebuffer);
+            glDeleteTextures(1, &texture);
+            return 0;
+        }
+
+        // Drawing on the target puts the top row at the top of the texture, the same
+        // upside down way CreateImage stores images, so the usual coordinates work.
+        const float texCoords[] = { 0, 0, float(width) / texwidth, float(height) / texheight };
+        Texture* tex = new Texture(texture, texwidth, texheight, width, height);
+        tex->framebuffer = framebuffer;
+        tex->refCount++;
+
+        Image* img = new Image(tex, texCoords, width, height);
+        _renderTargets.insert(img);
+        return img;
+    }
+
+    bool Driver::RenderTo(Video::Image* i) {
+        Image* img = static_cast<Image*>(i);
+
+        if (img == _target) {
+            return true;
+        }
+        if (img && !_renderTargets.count(img)) {
+            return false;
+        }
+
+        if (!_target) {
+            // Remember the screen's clip rect for when we come back to it.
+            glGetIntegerv(GL_SCISSOR_BOX, _screenClip);
+        }
+
+        _target = img;
+
+        if (img) {
+            glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, img->_texture->framebuffer);
+            SetViewport(img->_width, img->_height);
+            glScissor(0, 0, img->_width, img->_height);
+        } else {
+            glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+            SetViewport(_doubleSize ? _xres * 2 : _xres, _doubleSize ? _yres * 2 : _yres);
+            glScissor(_screenClip[0], _screenClip[1], _screenClip[2], _screenClip[3]);
+        }
+
+        return true;
+    }
+
+    void Driver::SetViewport(int width, int height) {
+        glLoadIdentity();
+        glScalef(2.0f / float(width), -2.0f / float(height), 1.0f);
+        glTranslatef(-(float(width) / 2.0f), -(float(height) / 2.0f), 0.0f);
+        glViewport(0, 0, width, height);
+    }
+
+    int Driver::SurfaceHeight() const {
+        return _target ? _target->_height : _yres;
+    }
+
+    int Driver::SurfaceOffset() const {
+        return (_doubleSize && !_target) ? _yres : 0;
+    }
+
     void Driver::FreeImage(Video::Image* img) {
         if (!img) {
             return;
@@ -271,21 +473,26 @@ namespace OpenGL {
 
         SwitchTexture(0);
 
+        if (img == _target) {
+            RenderTo(0);
+        }
+        _renderTargets.erase(static_cast<OpenGL::Image*>(img));
+
         // Refcount update/cleanup
         Texture* tex = static_cast<OpenGL::Image*>(img)->_texture;
 
-#ifdef SHARE_TEXTURES
         if (tex->refCount == 1) {
+#ifdef SHARE_TEXTURES
             _textures.erase(tex);
+#endif
+            if (tex->framebuffer) {
+                glDeleteFramebuffersEXT(1, &tex->framebuffer);
+            }
             glDeleteTextures(1, &tex->handle);
             delete tex;
         } else {
             tex->refCount--;
         }
-#else
-        glDeleteTextures(1, &tex->handle);
-        delete tex;
-#endif
 
         delete (OpenGL::Image*)img;
     }
@@ -304,12 +511,8 @@ namespace OpenGL {
         int width = right - left;
         int height = bottom - top;
 
-        if (_doubleSize) {
-            top = min(_yres, _yres - top) - height;
-            top = top + _yres;
-        } else {
-            top = min(_yres, _yres - top) - height;
-        }
+        const int surfaceHeight = SurfaceHeight();
+        top = min(surfaceHeight, surfaceHeight - top) - height + SurfaceOffset();
 
         glScissor(
             left, top,
@@ -323,15 +526,16 @@ namespace OpenGL {
 
         int height = cliprect[3];
         // Get the y coordinate, compensated for doublesize.
-        int y = cliprect[1];
-        if (_doubleSize) y -= _yres;
+        int y = cliprect[1] - SurfaceOffset();
 
-        y = _yres - y - height;
+        y = SurfaceHeight() - y - height;
 
         return new Rect(cliprect[0], y, cliprect[0] + cliprect[2], y + height);
     }
 
     void Driver::ShowPage() {
+        RenderTo(0);
+
         if (_doubleSize) {
             // Grab the whole screen into our buffer texture and draw it at double size.
             glDisable(GL_BLEND);
@@ -369,12 +573,20 @@ namespace OpenGL {
         }
 
         fps.Update();
+        _frameCount++;
         SDL_GL_SwapBuffers();
         glClear(GL_COLOR_BUFFER_BIT);
     }
 
     void Driver::ClearScreen() {
-        glClear(GL_COLOR_BUFFER_BIT);
+        if (_target) {
+            // Render targets are cleared to transparent, so they can be drawn over things.
+            glClearColor(0, 0, 0, 0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glClearColor(0, 0, 0, 1);
+        } else {
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
     }
 
     Video::BlendMode Driver::SetBlendMode(Video::BlendMode bm) {
@@ -934,38 +1146,29 @@ namespace OpenGL {
             return 0;
         }
 
-        if (_doubleSize) {
-            y2 -= _yres;
-        }
-
         int texwidth = nextPowerOf2(w);
         int texheight = nextPowerOf2(h);
         uint handle;
         glGenTextures(1, &handle);
         SwitchTexture(handle);
-        glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x1, _yres - y2, texwidth, texheight, 0);
+        glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x1, SurfaceHeight() - y2 + SurfaceOffset(), texwidth, texheight, 0);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         const float texCoords[] = { 0, 0, float(w) / texwidth, float(h) / texheight };
-        Texture* tex = new Texture(handle, texwidth, texheight);
+        Texture* tex = new Texture(handle, texwidth, texheight, w, h);
         tex->refCount++;
         return new Image(tex, texCoords, w, h);
     }
 
-    Canvas* Driver::GrabCanvas(int x1, int y1, int x2, int y2) {
+    Rect Driver::ReadRect(int x1, int y1, int x2, int y2) const {
         /*
          * Have to convert from the raster-coordinates that ika uses to
          * Cartesian coords, which is what OpenGL favours.
          */
-        y1 = _yres - y1;
-        y2 = _yres - y2;
-
-        if (_doubleSize) { 
-            y1 += _yres; 
-            y2 += _yres; 
-        }
+        y1 = SurfaceHeight() - y1 + SurfaceOffset();
+        y2 = SurfaceHeight() - y2 + SurfaceOffset();
 
         // clip
         if (x1 > x2) {
@@ -975,18 +1178,107 @@ namespace OpenGL {
             swap(y1, y2);
         }
 
-        int w = x2 - x1;
-        int h = y2 - y1;
-        if (w < 0 || h < 0) {
-            return 0;
-        }
+        return Rect(x1, y1, x2, y2);
+    }
+
+    Canvas* Driver::GrabCanvas(int x1, int y1, int x2, int y2) {
+        const Rect r = ReadRect(x1, y1, x2, y2);
+        int w = r.Width();
+        int h = r.Height();
 
         Canvas* c = new Canvas(w, h);
-        glReadPixels(x1, y1, w, h, GL_RGBA, GL_UNSIGNED_BYTE, c->GetPixels());
+        glReadPixels(r.left, r.top, w, h, GL_RGBA, GL_UNSIGNED_BYTE, c->GetPixels());
         c->Flip();
         return c;
     }
 
+    uint Driver::BeginGrabCanvas(int x1, int y1, int x2, int y2) {
+        const Rect rect = ReadRect(x1, y1, x2, y2);
+
+        Readback r;
+        r.buffer = 0;
+        r.fence = 0;
+        r.frame = _frameCount;
+        r.width = rect.Width();
+        r.height = rect.Height();
+        r.canvas = 0;
+
+        if (!glGenBuffersARB) {
+            r.canvas = GrabCanvas(x1, y1, x2, y2);
+        } else {
+            // glReadPixels into a buffer object returns as soon as the copy is queued.
+            glGenBuffersARB(1, &r.buffer);
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, r.buffer);
+            glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, r.width * r.height * sizeof(RGBA), 0, GL_STREAM_READ_ARB);
+            glReadPixels(rect.left, rect.top, r.width, r.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+            if (glFenceSync) {
+                r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+        }
+
+        _readbacks[++_nextReadback] = r;
+        return _nextReadback;
+    }
+
+    Canvas* Driver::FinishGrabCanvas(uint ticket, bool wait) {
+        std::map<uint, Readback>::iterator iter = _readbacks.find(ticket);
+        if (iter == _readbacks.end()) {
+            return 0;
+        }
+
+        Readback& r = iter->second;
+
+        if (!r.canvas) {
+            bool ready = wait;
+            if (!ready && r.fence) {
+                const uint status = glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+                ready = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+            } else if (!ready) {
+                // No way to ask.  By now the frame it came from has been shown, so it's very likely done.
+                ready = _frameCount - r.frame >= 2;
+            }
+
+            if (!ready) {
+                return 0;
+            }
+
+            r.canvas = new Canvas(r.width, r.height);
+
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, r.buffer);
+            const RGBA* pixels = (const RGBA*)glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+            if (pixels) {
+                // Flip it while copying.  GL's rows go upward.
+                for (int y = 0; y < r.height; y++) {
+                    const RGBA* src = pixels + (r.height - y - 1) * r.width;
+                    std::copy(src, src + r.width, r.canvas->GetPixels() + y * r.width);
+                }
+                glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+            } else {
+                Log::Write("Unable to map a screen grab's pixel buffer.");
+            }
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+            FreeReadback(r);
+        }
+
+        Canvas* c = r.canvas;
+        _readbacks.erase(iter);
+        return c;
+    }
+
+    void Driver::FreeReadback(Readback& r) {
+        if (r.fence) {
+            glDeleteSync(r.fence);
+            r.fence = 0;
+        }
+        if (r.buffer) {
+            glDeleteBuffersARB(1, &r.buffer);
+            r.buffer = 0;
+        }
+    }
+
     u32 Driver::GetTint() {
         return _tintColour;
     }
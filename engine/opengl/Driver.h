@@ -2,9 +2,8 @@
 
 //#define SHARE_TEXTURES
 
-#ifdef SHARE_TEXTURES
-#   include <set>
-#endif
+#include <map>
+#include <set>
 
 //#define PREMULTIPLY_ALPHA
 
@@ -12,6 +11,7 @@
 
 #include "../video/Driver.h"
 #include "../../common/Canvas.h"
+#include "../../common/memstats.h"
 #include "../../common/types.h"
 
 #include "../FPSCounter.h"
@@ -30,17 +30,30 @@ namespace OpenGL {
         int width;
         int height;
         uint refCount;
+        uint framebuffer;   // nonzero if this is a render target
 
         Point unused;   // where the next image should go
+        uint padding;   // bytes that no image uses
 
     protected:
-        Texture(uint p = 0, int w = 0, int h = 0)
+        // usedWidth and usedHeight are how much of the texture holds the image.  The rest is padding.
+        Texture(uint p, int w, int h, int usedWidth, int usedHeight)
             : handle(p)
             , width(w)
             , height(h)
             , refCount(0)
+            , framebuffer(0)
             , unused(0, 0)
-        {}
+            , padding((w * h - usedWidth * usedHeight) * sizeof(RGBA))
+        {
+            MemStats::Allocate(MemStats::texture, w * h * sizeof(RGBA) - padding);
+            MemStats::Allocate(MemStats::texturePadding, padding);
+        }
+
+        ~Texture() {
+            MemStats::Free(MemStats::texture, width * height * sizeof(RGBA) - padding);
+            MemStats::Free(MemStats::texturePadding, padding);
+        }
 
     private:
         // NO
@@ -69,9 +82,18 @@ namespace OpenGL {
         /// Creates a new image from the provided pixel buffer.
         virtual Image* CreateImage(Canvas &pm);
 
+        /// Creates an image from a piece of another, on the same texture.
+        virtual Image* CreateSubImage(Video::Image* img, int x, int y, int w, int h);
+
         /// Frees the previously created image.
         virtual void FreeImage(Video::Image* img);
 
+        /// Creates an image backed by a framebuffer object.  Returns 0 if EXT_framebuffer_object isn't there.
+        virtual Image* CreateRenderTarget(int width, int height);
+
+        /// Binds a render target's framebuffer, or the screen's if i is 0.
+        virtual bool RenderTo(Video::Image* i);
+
         /// Clips the image to the provided rectangle.
         virtual void ClipScreen(int left, int top, int right, int bottom);
 
@@ -84,6 +106,10 @@ namespace OpenGL {
         /// Clears the screen!  With blackness!
         virtual void ClearScreen();
 
+        /// Always false: the back buffer is undefined after a swap, so every frame is drawn in full.
+        virtual bool RetainsScreen() const { return false; }
+        virtual void SetDirtyRegion(const std::vector<Rect>&) {}
+
         /// Sets the current blend mode.
         virtual Video::BlendMode SetBlendMode(Video::BlendMode bm);
 
@@ -151,6 +177,13 @@ namespace OpenGL {
         /// Like GrabImage, but stores the contents on a canvas, not an image
         virtual Canvas* GrabCanvas(int x1, int y1, int x2, int y2);
 
+        /// Reads into a pixel buffer object, so the CPU doesn't wait for the GPU to catch up.
+        /// Without ARB_pixel_buffer_object, it does a GrabCanvas on the spot.
+        virtual uint BeginGrabCanvas(int x1, int y1, int x2, int y2);
+
+        /// A grab is ready once its fence has passed, or (without ARB_sync) two ShowPages later.
+        virtual Canvas* FinishGrabCanvas(uint ticket, bool wait);
+
         /// Sets the current tint colour.  This tint is applied to *everything*
         virtual u32 GetTint();
 
@@ -186,11 +219,57 @@ namespace OpenGL {
         uint _lasttex;
         void SwitchTexture(uint tex);
 
+        // Render targets.  Everything is drawn on _target, if it's set, instead of the screen.
+        std::set<Image*> _renderTargets;
+        Image* _target;
+        int _screenClip[4];                                 ///< the screen's scissor box, while a target is bound
+
+        void SetViewport(int width, int height);            ///< Sets up the matrix and viewport so that one unit is one pixel, with y going down.
+        int SurfaceHeight() const;                          ///< Height of whatever's being drawn on.
+        int SurfaceOffset() const;                          ///< Where that starts, in GL's upward y.  In doublesize, the screen is drawn in the top half.
+
+        Rect ReadRect(int x1, int y1, int x2, int y2) const;    ///< Converts a rectangle of the surface to glReadPixels coordinates.
+
+        // Grabs in progress.
+        struct Readback {
+            uint buffer;                                    ///< pixel buffer object holding the pixels, or 0 if canvas is already filled in
+            void* fence;                                    ///< passes once the pixels are in buffer.  0 without ARB_sync.
+            uint frame;                                     ///< _frameCount when it was started
+            int width, height;
+            Canvas* canvas;
+        };
+
+        std::map<uint, Readback> _readbacks;
+        uint _nextReadback;
+        uint _frameCount;                                   ///< ShowPages so far
+
+        void FreeReadback(Readback& r);
+
 #ifdef SHARE_TEXTURES
         typedef std::set<Texture*> TextureSet;
         TextureSet _textures;  // textures allocated.  Only used for 16x16 images at this moment.
 #endif
 
         void (IKA_STDCALL *glBlendEquationEXT)(int);
+
+        // EXT_framebuffer_object.  glGenFramebuffersEXT is 0 if it isn't supported.
+        void (IKA_STDCALL *glGenFramebuffersEXT)(int, uint*);
+        void (IKA_STDCALL *glDeleteFramebuffersEXT)(int, const uint*);
+        void (IKA_STDCALL *glBindFramebufferEXT)(uint, uint);
+        void (IKA_STDCALL *glFramebufferTexture2DEXT)(uint, uint, uint, uint, int);
+        uint (IKA_STDCALL *glCheckFramebufferStatusEXT)(uint);
+
+        // ARB_pixel_buffer_object (with the ARB_vertex_buffer_object functions it uses).  glGenBuffersARB is 0 if it isn't supported.
+        void (IKA_STDCALL *glGenBuffersARB)(int, uint*);
+        void (IKA_STDCALL *glDeleteBuffersARB)(int, const uint*);
+        void (IKA_STDCALL *glBindBufferARB)(uint, uint);
+        void (IKA_STDCALL *glBufferDataARB)(uint, ptrdiff_t, const void*, uint);
+        void* (IKA_STDCALL *glMapBufferARB)(uint, uint);
+        u8 (IKA_STDCALL *glUnmapBufferARB)(uint);
+
+        // ARB_sync.  glFenceSync is 0 if it isn't supported.
+        void* (IKA_STDCALL *glFenceSync)(uint, uint);
+        uint (IKA_STDCALL *glClientWaitSync)(void*, uint, u64);
+        void (IKA_STDCALL *glDeleteSync)(void*);
     };
 };
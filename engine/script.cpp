@@ -3,6 +3,7 @@
 
 #include "script.h"
 
+#include "common/Canvas.h"
 #include "common/fileio.h"
 #include "common/log.h"
 #include "common/version.h"
@@ -15,6 +16,43 @@ using namespace Script;
 
 bool ScriptEngine::_inited = false;
 
+namespace {
+    // Movement and render scripts are called for every entity, every tick.  Rather than
+    // building a new argument tuple each time, we keep one spare per signature and refill it.
+    // A tuple is only put back if nothing else kept a reference to it, and it is taken out
+    // while in use so that nested calls (a movescript calling Entity.Update, say) get their own.
+    PyObject* entityArgs = 0;                   // (entity)
+    PyObject* renderArgs = 0;                   // (entity, x, y, frame)
+
+    PyObject* AcquireArgs(PyObject*& spare, int count) {
+        PyObject* args = spare;
+        spare = 0;
+        return args ? args : PyTuple_New(count);
+    }
+
+    // Steals a reference to item unless borrowed is set.
+    void SetArg(PyObject* args, int index, PyObject* item, bool borrowed = true) {
+        if (borrowed) {
+            Py_INCREF(item);
+        }
+        PyTuple_SET_ITEM(args, index, item);
+    }
+
+    // Empties the tuple so that it does not keep entities alive between calls.
+    void ReleaseArgs(PyObject*& spare, PyObject* args) {
+        if (spare != 0 || Py_REFCNT(args) != 1) {
+            Py_DECREF(args);
+            return;
+        }
+
+        for (int i = 0; i < PyTuple_GET_SIZE(args); i++) {
+            PyObject* item = PyTuple_GET_ITEM(args, i);
+            PyTuple_SET_ITEM(args, i, 0);
+            Py_XDECREF(item);
+        }
+        spare = args;
+    }
+}
 
 /* Remove if not useful. copypasted. */
 /*
@@ -61,6 +99,7 @@ PyObject* PyInit_ika(void) {
     Script::Music::Init();
     Script::Sound::Init();
     Script::Font::Init();
+    Script::TextLayout::Init();
     Script::Canvas::Init();
     Script::Control::Init();
     Script::InputDevice::Init();
@@ -96,10 +135,15 @@ PyObject* PyInit_ika(void) {
 	PyModule_AddIntConstant(module, "MultiplyBlend", 5);
 	PyModule_AddIntConstant(module, "PreserveBlend", 6);
 
+    PyModule_AddIntConstant(module, "NearestFilter", Blitter::nearestFilter);
+    PyModule_AddIntConstant(module, "BilinearFilter", Blitter::bilinearFilter);
+    PyModule_AddIntConstant(module, "BoxFilter", Blitter::boxFilter);
+
     PyModule_AddObject(module, "Version", PyBytes_FromString(IKA_VERSION));
 
     Py_INCREF(&Script::Entity::type);   PyModule_AddObject(module, "Entity", (PyObject*)&Script::Entity::type);
     Py_INCREF(&Script::Font::type);     PyModule_AddObject(module, "Font",  (PyObject*)&Script::Font::type);
+    Py_INCREF(&Script::TextLayout::type); PyModule_AddObject(module, "TextLayout", (PyObject*)&Script::TextLayout::type);
     Py_INCREF(&Script::Canvas::type);   PyModule_AddObject(module, "Canvas", (PyObject*)&Script::Canvas::type);
     Py_INCREF(&Script::Image::type);    PyModule_AddObject(module, "Image", (PyObject*)&Script::Image::type);
     Py_INCREF(&Script::Music::type);    PyModule_AddObject(module, "Music", (PyObject*)&Script::Music::type);
@@ -137,6 +181,9 @@ void ScriptEngine::Shutdown() {
     Py_XDECREF(entityDict);
     Py_XDECREF(cameraTarget);
 
+    Py_XDECREF(entityArgs);
+    Py_XDECREF(renderArgs);
+
     Py_XDECREF(sysModule);
     Py_XDECREF(mapModule);
 
@@ -226,7 +273,7 @@ void ScriptEngine::ExecObject(const ScriptObject& func) {
 void ScriptEngine::ExecObject(const ScriptObject& func, const ::Entity* ent) {
     CDEBUG("ScriptEngine::ExecObject");
 
-    Script::Entity::EntityObject* entObject = Script::Entity::instances[const_cast< ::Entity*>(ent)];
+    PyObject* entObject = (PyObject*)ent->scriptObject;
     assert(entObject);
 
     if (func.get() == 0) {
@@ -234,9 +281,11 @@ void ScriptEngine::ExecObject(const ScriptObject& func, const ::Entity* ent) {
         return;
     }
 
-    PyObject* args = Py_BuildValue("(O)", entObject);
-    PyObject* result = PyEval_CallObject((PyObject*)func.get(), args);
-    Py_DECREF(args);
+    PyObject* args = AcquireArgs(entityArgs, 1);
+    SetArg(args, 0, entObject);
+
+    PyObject* result = PyObject_Call((PyObject*)func.get(), args, 0);
+    ReleaseArgs(entityArgs, args);
 
     if (result == 0) {
         PyErr_Print();
@@ -249,8 +298,7 @@ void ScriptEngine::ExecObject(const ScriptObject& func, const ::Entity* ent) {
 void ScriptEngine::ExecObject(const ScriptObject& func, const ::Entity* ent, int x, int y, uint frame) {
     CDEBUG("ScriptEngine::ExecObject");
 
-    Script::Entity::EntityObject* entObject =
-		Script::Entity::instances[const_cast< ::Entity*>(ent)];
+    PyObject* entObject = (PyObject*)ent->scriptObject;
     assert(entObject != 0);
 
     if (func.get() == 0) {
@@ -258,9 +306,35 @@ void ScriptEngine::ExecObject(const ScriptObject& func, const ::Entity* ent, int
         return;
     }
 
-    PyObject* args = Py_BuildValue("(Oiii)", entObject, x, y, frame);
-    PyObject* result = PyEval_CallObject((PyObject*)func.get(), args);
-    Py_DECREF(args);
+    PyObject* args = AcquireArgs(renderArgs, 4);
+    SetArg(args, 0, entObject);
+    SetArg(args, 1, PyLong_FromLong(x), false);
+    SetArg(args, 2, PyLong_FromLong(y), false);
+    SetArg(args, 3, PyLong_FromLong(frame), false);
+
+    PyObject* result = PyObject_Call((PyObject*)func.get(), args, 0);
+    ReleaseArgs(renderArgs, args);
+
+    if (result == 0) {
+        PyErr_Print();
+        engine->Script_Error();
+    }
+
+    Py_DECREF(result);
+}
+
+void ScriptEngine::ExecObject(const ScriptObject& func, ::Canvas* canvas) {
+    CDEBUG("ScriptEngine::ExecObject");
+
+    if (func.get() == 0) {
+        Log::Write("Attempt to call null object");
+        delete canvas;
+        return;
+    }
+
+    PyObject* canvasObject = Script::Canvas::New(canvas);
+    PyObject* result = PyObject_CallFunctionObjArgs((PyObject*)func.get(), canvasObject, 0);
+    Py_DECREF(canvasObject);
 
     if (result == 0) {
         PyErr_Print();
@@ -324,10 +398,8 @@ void ScriptEngine::CallScript(const std::string& name) {
 }
 
 void ScriptEngine::CallScript(const std::string& name, const ::Entity* ent) {
-    assert(Script::Entity::instances.count(const_cast< ::Entity*>(ent)));
-
-    Script::Entity::EntityObject* entObject =
-		Script::Entity::instances[const_cast< ::Entity*>(ent)];
+    PyObject* entObject = (PyObject*)ent->scriptObject;
+    assert(entObject != 0);
 
     PyObject* dict = PyModule_GetDict(mapModule);
     PyObject* func = PyDict_GetItemString(dict, const_cast<char*>(name.c_str()));
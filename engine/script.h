@@ -9,6 +9,7 @@
 struct Engine;                                  // proto
 struct ScriptObject;
 struct Entity;
+struct Canvas;
 
 /**
  *  Python API encapsulation class.
@@ -26,6 +27,7 @@ struct ScriptEngine {
     void ExecObject(const ScriptObject& func);
     void ExecObject(const ScriptObject& func, const Entity* ent);       // needed for entity movescripts.  Passes the entity as an argument to the function object.
     void ExecObject(const ScriptObject& func, const Entity* ent, int x, int y, uint frame);       // Used for entity renderscripts.  Passes the entity, along with three ints.
+    void ExecObject(const ScriptObject& func, Canvas* canvas);          // Passes a new canvas object to the function.  The script owns the canvas afterwards.
 
     ScriptObject GetObjectFromMapScript(const std::string& name);       // a bit verbose, but it says what it does.
 
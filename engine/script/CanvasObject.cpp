@@ -45,11 +45,22 @@ namespace Script
             },
 
             {   "ScaleBlit", (PyCFunction)Canvas_ScaleBlit,  METH_VARARGS,
-                "Canvas.ScaleBlit(destcanvas, x, y, width, height, blendmode)\n\n"
+                "Canvas.ScaleBlit(destcanvas, x, y, width, height, [blendmode, filter])\n\n"
                 "Draws the image on destcanvas, at position (x, y), scaled to (width, height) pixels in size.\n"
 				"blendmode specifies the algorithm used to blend pixels.  It is one of\n"
 				"the available blend modes defined in ika's constants section.\n"
-                "blendmode defaults to ika.AlphaBlend."
+                "blendmode defaults to ika.AlphaBlend.\n\n"
+                "filter is one of ika.NearestFilter (the default; fast, but blocky), ika.BilinearFilter\n"
+                "(smooth, for enlarging) or ika.BoxFilter (averages, for shrinking).  Only\n"
+                "ika.NearestFilter can mirror the image with a negative width or height."
+            },
+
+            {   "MakeMipChain", (PyCFunction)Canvas_MakeMipChain, METH_NOARGS,
+                "Canvas.MakeMipChain() -> list\n\n"
+                "Returns a list of new canvases, each half the size of the one before it, down to 1x1.\n"
+                "The first is half the size of the canvas's clip rectangle.  Each pixel is the average\n"
+                "of the four it was shrunk from.  Handy for keeping one big image around, and making\n"
+                "smaller ones when they're needed."
             },
 
             {   "TileBlit", (PyCFunction)Canvas_TileBlit,   METH_VARARGS,
@@ -160,7 +171,7 @@ namespace Script
 
         PyObject* New(::Canvas* c)
         {
-            CanvasObject* canvas = PyObject_New(CanvasObject, &type);
+            CanvasObject* canvas = NewObject<CanvasObject>(&type);
             canvas->canvas = c;
             canvas->ref = false;
             return (PyObject*)canvas;
@@ -184,7 +195,7 @@ namespace Script
                     return 0;
                 }
 
-                CanvasObject* c = PyObject_New(CanvasObject, type);
+                CanvasObject* c = NewObject<CanvasObject>(type);
                 c->canvas = new ::Canvas(x, y);
                 c->ref = false;
 
@@ -193,7 +204,7 @@ namespace Script
             else if (o->ob_type == &PyBytes_Type)
             {
                 char* fname = PyBytes_AsString(o);
-                CanvasObject* c = PyObject_New(CanvasObject, type);
+                CanvasObject* c = NewObject<CanvasObject>(type);
                 try {
                     c->canvas = new ::Canvas(fname);
                     c->ref = false;
@@ -213,7 +224,7 @@ namespace Script
             if (!self->ref)
                 delete self->canvas;
 
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x)  PyObject* x(CanvasObject* self, PyObject* args)
@@ -260,16 +271,34 @@ namespace Script
             int x, y;
             int w, h;
             ::Video::BlendMode blendMode = ::Video::Normal;
+            int filter = Blitter::nearestFilter;
 
-            if (!PyArg_ParseTuple(args, "O!iiii|i:ScaleBlit", &type, &dest, &x, &y, &w, &h, &blendMode))
+            if (!PyArg_ParseTuple(args, "O!iiii|ii:ScaleBlit", &type, &dest, &x, &y, &w, &h, &blendMode, &filter))
                 return 0;
 
-            Blitter::ScaleBlit(*self->canvas, *dest->canvas, x, y, w, h, *Blitter::GetBlender(blendMode));
+            if (filter < Blitter::nearestFilter || filter > Blitter::boxFilter) {
+                PyErr_SetString(PyExc_RuntimeError, va("%i is not a valid filter.", filter));
+                return 0;
+            }
+
+            Blitter::ScaleBlit(*self->canvas, *dest->canvas, x, y, w, h, Blitter::Filter(filter), *Blitter::GetBlender(blendMode));
 
             Py_INCREF(Py_None);
             return Py_None;
         }
 
+        METHOD1(Canvas_MakeMipChain)
+        {
+            std::vector< ::Canvas*> levels;
+            self->canvas->MakeMipChain(levels);
+
+            PyObject* list = PyList_New(levels.size());
+            for (uint i = 0; i < levels.size(); i++) {
+                PyList_SET_ITEM(list, i, New(levels[i]));
+            }
+            return list;
+        }
+
         METHOD(Canvas_TileBlit)
         {
             CanvasObject* dest;
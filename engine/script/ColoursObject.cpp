@@ -58,7 +58,7 @@ namespace Script {
         }
 
         PyObject* New(ColourHandler* handler) {
-            ColoursObject* coloursObject = PyObject_New(ColoursObject, &type);
+            ColoursObject* coloursObject = NewObject<ColoursObject>(&type);
 
             if (!coloursObject)
                 return 0;
@@ -67,7 +67,7 @@ namespace Script {
         }
 
         void Destroy(ColoursObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
         
         PyObject* Colours_GetItem(ColoursObject* self, PyObject* key) {
@@ -97,7 +97,7 @@ namespace Script {
                 return (PyObject*)c;
             }
 
-            ControlObject* ctrl = PyObject_New(ControlObject, &type);
+            ControlObject* ctrl = NewObject<ControlObject>(&type);
 
             ctrl->control = control;
             _instances[control] = ctrl;
@@ -108,7 +108,7 @@ namespace Script {
         void Destroy(ControlObject* self) {
             _instances.erase(self->control);
 
-            PyObject_Del(self);
+            DelObject(self);
         }
 
         PyObject* Control_Pressed(ControlObject* self) {
@@ -176,6 +176,7 @@ namespace Script {
                     );
                 } else {
                     self->ent->layerIndex = i;
+                    engine->InvalidateLayerEntities();
                 }
                 return 0;
             }
@@ -187,9 +188,9 @@ namespace Script {
 
                 Direction dir = self->ent->direction;
                 if (!self->ent->isMoving) {
-                    self->ent->SetAnimScript(self->ent->sprite->GetWalkScript(dir));
+                    self->ent->SetAnimScript(self->ent->sprite->GetWalkProgram(dir));
                 } else {
-                    self->ent->SetAnimScript(self->ent->sprite->GetIdleScript(dir));
+                    self->ent->SetAnimScript(self->ent->sprite->GetIdleProgram(dir));
                 }
 
                 self->ent->UpdateAnimation();
@@ -242,9 +243,9 @@ namespace Script {
 
                 Direction dir = self->ent->direction;
                 if (!self->ent->isMoving)
-                    self->ent->SetAnimScript(self->ent->sprite->GetWalkScript(dir));
+                    self->ent->SetAnimScript(self->ent->sprite->GetWalkProgram(dir));
                 else
-                    self->ent->SetAnimScript(self->ent->sprite->GetIdleScript(dir));
+                    self->ent->SetAnimScript(self->ent->sprite->GetIdleProgram(dir));
                 self->ent->UpdateAnimation();
                 return 0;
             }
@@ -308,12 +309,13 @@ namespace Script {
         }
 
         PyObject* New(::Entity* e) {
-            EntityObject* ent = PyObject_New(EntityObject, &type);
+            EntityObject* ent = NewObject<EntityObject>(&type);
             if (!ent) {
                 return 0;
             }
 
             ent->ent = e;
+            e->scriptObject = ent;
 
             instances[ent->ent] = ent;
 
@@ -364,11 +366,12 @@ namespace Script {
         void Destroy(EntityObject* self) {
             assert(self->ent);
 
-            engine->DestroyEntity(self->ent);
-
             instances.erase(self->ent);
+            self->ent->scriptObject = 0;
+
+            engine->DestroyEntity(self->ent);
 
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(EntityObject* self, PyObject* args)
@@ -62,11 +62,11 @@ namespace Script {
         }
 
         PyObject* New() {
-            return (PyObject*)PyObject_New(PyObject, &type);
+            return (PyObject*)NewObject<PyObject>(&type);
         }
 
         void Destroy(PyObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(PyObject* /*self*/, PyObject* args)
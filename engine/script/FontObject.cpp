@@ -37,6 +37,14 @@ namespace Script {
                 "Returns how many pixels in height the passed string would be, \n"
                 "if printed in this font.  Takes newlines into account."
             },            
+            {   (char*)"RenderToImage",  (PyCFunction)Font_RenderToImage,  METH_VARARGS,
+                (char*)"Font.RenderToImage(text[, colour[, subset]]) -> Image\n\n"
+                "Returns an image of the string, as it would be printed in this font.\n"
+                "colour and subset are what the text starts out in, before any #[colour]\n"
+                "or ~subset codes in the string change them.\n"
+                "Images are cached, so asking for the same text again is cheap, and\n"
+                "drawing the image is much faster than printing the text."
+            },
             {   0,           0    }
         };
 
@@ -45,13 +53,15 @@ namespace Script {
         GET(Width)         { return PyLong_FromLong(self->font->Width()); }
         GET(Height)        { return PyLong_FromLong(self->font->Height()); }
         GET(TabSize)       { return PyLong_FromLong(self->font->TabSize()); }
-        SET(TabSize)       { self->font->SetTabSize(PyLong_AsLong(value)); return 0; }
+        SET(TabSize)       { self->font->SetTabSize(PyLong_AsLong(value)); PyDict_Clear(self->images); return 0; }
         GET(LetterSpacing) { return PyLong_FromLong(self->font->LetterSpacing()); }
-        SET(LetterSpacing) { self->font->SetLetterSpacing(PyLong_AsLong(value)); return 0; }
+        SET(LetterSpacing) { self->font->SetLetterSpacing(PyLong_AsLong(value)); PyDict_Clear(self->images); return 0; }
         GET(WordSpacing)   { return PyLong_FromLong(self->font->WordSpacing()); }
-        SET(WordSpacing)   { self->font->SetWordSpacing(PyLong_AsLong(value)); return 0; }        
+        SET(WordSpacing)   { self->font->SetWordSpacing(PyLong_AsLong(value)); PyDict_Clear(self->images); return 0; }        
         GET(LineSpacing)   { return PyLong_FromLong(self->font->WordSpacing()); }
-        SET(LineSpacing)   { self->font->SetLineSpacing(PyLong_AsLong(value)); return 0; }        
+        SET(LineSpacing)   { self->font->SetLineSpacing(PyLong_AsLong(value)); PyDict_Clear(self->images); return 0; }        
+        GET(CacheStrings)  { return PyLong_FromLong(self->cacheStrings ? 1 : 0); }
+        SET(CacheStrings)  { self->cacheStrings = PyObject_IsTrue(value) == 1; return 0; }
 #undef GET
 #undef SET
 
@@ -62,6 +72,8 @@ namespace Script {
             {   (char*)"letterspacing", (getter)getLetterSpacing,(setter)setLetterSpacing, (char*)"Gets or sets the letter spacing of the font."   },
             {   (char*)"wordspacing",   (getter)getWordSpacing,  (setter)setWordSpacing,   (char*)"Gets or sets the word spacing of the font."   },
             {   (char*)"linespacing",   (getter)getLineSpacing,  (setter)setLineSpacing,   (char*)"Gets or sets the line spacing of the font."   },
+            {   (char*)"cachestrings",  (getter)getCacheStrings, (setter)setCacheStrings,  (char*)"If nonzero, printed strings are rendered to images once and\n"
+                                                                                                   "reused.  Use this for text that does not change from frame to frame."   },
             {   0   }
         };
 
@@ -91,7 +103,7 @@ namespace Script {
                 return 0;
             }
 
-            FontObject* font = PyObject_New(FontObject, type);
+            FontObject* font = NewObject<FontObject>(type);
             if (!font) {
                 return 0;
             }
@@ -103,13 +115,62 @@ namespace Script {
                 return 0;
             }
 
+            font->images = PyDict_New();
+            font->cacheStrings = false;
+
             return (PyObject*)font;
         }
 
         void Destroy(FontObject* self) {
+            Py_XDECREF(self->images);
             delete self->font;
 
-            PyObject_Del(self);
+            DelObject(self);
+        }
+
+        const Py_ssize_t maxCachedImages = 64;
+
+        // Returns a borrowed reference to an image of the string, rendering it if it isn't cached.
+        PyObject* GetStringImage(FontObject* self, const char* text, u32 colour = RGBA(255, 255, 255, 255), uint subset = 0) {
+            PyObject* key = Py_BuildValue("(sIi)", text, colour, subset);
+            if (!key) {
+                return 0;
+            }
+
+            PyObject* image = PyDict_GetItem(self->images, key);
+
+            if (!image) {
+                // Crude, but anything still in use lives on regardless.
+                if (PyDict_Size(self->images) >= maxCachedImages) {
+                    PyDict_Clear(self->images);
+                }
+
+                ScopedPtr< ::Canvas> canvas(self->font->RenderString(text, subset, colour));
+                image = Script::Image::New(engine->video->CreateImage(*canvas));
+
+                if (image) {
+                    PyDict_SetItem(self->images, key, image);
+                    Py_DECREF(image);
+                }
+            }
+
+            Py_DECREF(key);
+            return image;
+        }
+
+        // Prints from the image cache if that's turned on.
+        void PrintString(FontObject* self, int x, int y, const char* text) {
+            if (self->cacheStrings) {
+                PyObject* image = GetStringImage(self, text);
+                if (image) {
+                    engine->video->SetBlendMode(::Video::Normal);
+                    engine->video->BlitImage(((Script::Image::ImageObject*)image)->img, x, y);
+                    return;
+                }
+                PyErr_Clear();
+            }
+
+            self->font->PrintString(x, y, text);
         }
 
 #define METHOD(x) PyObject* x(FontObject* self, PyObject* args)
@@ -121,7 +182,7 @@ namespace Script {
             if (!PyArg_ParseTuple(args, "iis:Font.Print", &x, &y, &message))
                 return 0;
 
-            self->font->PrintString(x, y, message);
+            PrintString(self, x, y, message);
 
             Py_INCREF(Py_None);
             return Py_None;
@@ -136,7 +197,7 @@ namespace Script {
             }
 
             Ika::Font* f = self->font;
-            f->PrintString(x - f->StringWidth(message) / 2 , y, message);
+            PrintString(self, x - f->StringWidth(message) / 2 , y, message);
 
             Py_INCREF(Py_None);
             return Py_None;
@@ -151,7 +212,7 @@ namespace Script {
             }
 
             Ika::Font* f = self->font;
-            f->PrintString(x - f->StringWidth(message) , y, message);
+            PrintString(self, x - f->StringWidth(message) , y, message);
 
             Py_INCREF(Py_None);
             return Py_None;
@@ -176,6 +237,20 @@ namespace Script {
 
             return PyLong_FromLong(self->font->StringHeight(message));
         }
+
+        METHOD(Font_RenderToImage) {
+            char* message;
+            u32 colour = RGBA(255, 255, 255, 255);
+            uint subset = 0;
+
+            if (!PyArg_ParseTuple(args, "s|Ii:Font.RenderToImage", &message, &colour, &subset)) {
+                return 0;
+            }
+
+            PyObject* image = GetStringImage(self, message, colour, subset);
+            Py_XINCREF(image);
+            return image;
+        }
         
 #undef METHOD
     }
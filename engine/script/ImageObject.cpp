@@ -136,11 +136,11 @@ namespace Script {
         void Destroy(ImageObject* self) {
             //delete self->img;
             engine->video->FreeImage(self->img);
-            PyObject_Del(self);
+            DelObject(self);
         }
 
         PyObject* New(::Video::Image* image) {
-            ImageObject* img = PyObject_New(ImageObject, &type);
+            ImageObject* img = NewObject<ImageObject>(&type);
             img->img = image;
             return (PyObject*)img;
         }
@@ -158,7 +158,7 @@ namespace Script {
 
                     ::Canvas img(filename);
 
-                    ImageObject* image = PyObject_New(ImageObject, type);
+                    ImageObject* image = NewObject<ImageObject>(type);
                     if (!image) {
                         PyErr_SetString(PyExc_MemoryError, "newimage: This should never happen. :o");
                         return 0;
@@ -174,7 +174,7 @@ namespace Script {
                 }
             }
             else if (obj->ob_type == &Script::Canvas::type) {
-                ImageObject* image = PyObject_New(ImageObject, type);
+                ImageObject* image = NewObject<ImageObject>(type);
                 if (!image)
                     return 0;
 
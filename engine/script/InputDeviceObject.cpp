@@ -47,7 +47,7 @@ namespace Script {
         }
 
         PyObject* New(::InputDevice* device) {
-            DeviceObject* obj = PyObject_New(DeviceObject, &type);
+            DeviceObject* obj = NewObject<DeviceObject>(&type);
 
             if (!obj)
                 return 0;
@@ -56,7 +56,7 @@ namespace Script {
         }
 
         void Destroy(DeviceObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x)  PyObject* x(DeviceObject* self, PyObject* args)
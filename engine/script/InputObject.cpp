@@ -175,7 +175,7 @@ namespace Script {
         }
 
         PyObject* New() {
-            InputObject* input = PyObject_New(InputObject, &type);
+            InputObject* input = NewObject<InputObject>(&type);
 
             if (!input) {
                 return 0;
@@ -195,7 +195,7 @@ namespace Script {
         }
 
         void Destroy(InputObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x)  PyObject* x(InputObject* self, PyObject* args)
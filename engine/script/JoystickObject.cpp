@@ -40,7 +40,7 @@ namespace Script {
         }
 
         PyObject* New(::Joystick* stick) {
-            JoystickObject* joy = PyObject_New(JoystickObject, &type);
+            JoystickObject* joy = NewObject<JoystickObject>(&type);
 
             joy->joystick = stick;
             joy->axes = PyTuple_New(stick->GetNumAxes());
@@ -66,7 +66,7 @@ namespace Script {
             Py_DECREF(self->axes);
             Py_DECREF(self->reverseAxes);
             Py_DECREF(self->buttons);
-            PyObject_Del(self);
+            DelObject(self);
         }
     }
 }
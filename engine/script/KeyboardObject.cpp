@@ -47,7 +47,7 @@ namespace Script {
         }
 
         PyObject* New() {
-            Script::InputDevice::DeviceObject* keyboard = PyObject_New(Script::InputDevice::DeviceObject, &type);
+            Script::InputDevice::DeviceObject* keyboard = NewObject<Script::InputDevice::DeviceObject>(&type);
             keyboard->device = the< ::Input>()->GetKeyboard();
 
             assert(keyboard != 0);
@@ -55,7 +55,7 @@ namespace Script {
         }
 
         void Destroy(PyObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(PyObject* /*self*/)
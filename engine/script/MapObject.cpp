@@ -4,6 +4,7 @@ Map manipulation junque.
 #include "ObjectDefs.h"
 #include "main.h"
 #include "common/fileio.h"
+#include "maprender.h"
 
 #include <cassert>
 
@@ -13,8 +14,10 @@ namespace Script {
 
         PyMethodDef methods[] = {
 			{   "Save",  (PyCFunction)Map_Save,   METH_VARARGS,
-                "Save(filename)\n\n"
-                "Saves the currently loaded map under filename."
+                "Save(filename[, fast])\n\n"
+                "Saves the currently loaded map under filename.\n"
+                "If fast is nonzero, the layers are compressed with a quicker setting, which\n"
+                "makes the file a little bigger."
             },
 
             {   "Switch",       (PyCFunction)Map_Switch,        METH_VARARGS,
@@ -143,6 +146,17 @@ namespace Script {
                 "Creates a list of every single existing entity, and returns it."
             },
 
+            {   "RenderToCanvas",   (PyCFunction)Map_RenderToCanvas,    METH_VARARGS,
+                "RenderToCanvas([layerList[, (x1, y1, x2, y2)[, scale]]]) -> Canvas\n\n"
+                "Draws tile layers onto a new canvas, for minimaps and map snapshots.\n"
+                "layerList is a list of layer indices, drawn in order.  None, or leaving it\n"
+                "out, means every layer.  The rectangle is in tiles, and defaults to the\n"
+                "whole map.  x2 and y2 are not included.\n"
+                "If scale is more than 1, the canvas is that many times smaller, each pixel\n"
+                "the average of the block it covers.\n"
+                "Entities are not drawn, and parallax and layer positions are ignored."
+            },
+
             {   0   }   // end of list
         };
 
@@ -256,13 +270,13 @@ namespace Script {
         }
 
         PyObject* New() {
-            PyObject* map = PyObject_New(PyObject, &type);
+            PyObject* map = NewObject<PyObject>(&type);
             assert(map != 0);
             return map;
         }
 
         void Destroy(PyObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(PyObject* /*self*/, PyObject* args)
@@ -271,10 +285,16 @@ namespace Script {
         METHOD(Map_Save)
         {
             char* fname;
-            if (!PyArg_ParseTuple(args, "s:Save", &fname))
+            int fast = 0;
+            if (!PyArg_ParseTuple(args, "s|i:Save", &fname, &fast))
                 return 0;
 
-            engine->map.Save(fname);
+            try {
+                engine->map.Save(fname, fast ? Compression::fast : Compression::normal);
+            } catch (std::runtime_error err) {
+                PyErr_SetString(PyExc_IOError, va("Unable to save %s: %s", fname, err.what()));
+                return 0;
+            }
 
             Py_INCREF(Py_None);
             return Py_None;
@@ -687,6 +707,63 @@ namespace Script {
             */
         }
 
+        METHOD(Map_RenderToCanvas) {
+            PyObject* layerList = 0;
+            Rect area(0, 0, 0, 0);
+            int scale = 1;
+
+            if (!PyArg_ParseTuple(args, "|O(iiii)i:Map.RenderToCanvas", &layerList, &area.left, &area.top, &area.right, &area.bottom, &scale)) {
+                return 0;
+            }
+
+            if (!engine->_isMapLoaded) {
+                PyErr_SetString(PyExc_RuntimeError, "Map.RenderToCanvas: Can't render a map before one is loaded.");
+                return 0;
+            }
+
+            std::vector<uint> layers;
+            if (!layerList || layerList == Py_None) {
+                for (uint i = 0; i < engine->map.NumLayers(); i++) {
+                    layers.push_back(i);
+                }
+            } else {
+                if (!PySequence_Check(layerList)) {
+                    PyErr_SetString(PyExc_TypeError, "Map.RenderToCanvas: layerList must be a list of layer indices.");
+                    return 0;
+                }
+
+                for (int i = 0; i < PySequence_Size(layerList); i++) {
+                    PyObject* item = PySequence_GetItem(layerList, i);
+                    long index = PyLong_Check(item) ? PyLong_AsLong(item) : -1;
+                    Py_DECREF(item);
+
+                    if (index < 0 || uint(index) >= engine->map.NumLayers()) {
+                        PyErr_SetString(PyExc_RuntimeError, va("Map.RenderToCanvas: %i is not a layer index.  The map has %i layers.", int(index), engine->map.NumLayers()));
+                        return 0;
+                    }
+                    layers.push_back(uint(index));
+                }
+            }
+
+            if (PyTuple_Size(args) < 2) {
+                for (uint i = 0; i < layers.size(); i++) {
+                    area.right = max(area.right, engine->map.GetLayer(layers[i])->Width());
+                    area.bottom = max(area.bottom, engine->map.GetLayer(layers[i])->Height());
+                }
+            }
+
+            if (area.right <= area.left || area.bottom <= area.top) {
+                PyErr_SetString(PyExc_RuntimeError, "Map.RenderToCanvas: the rectangle is empty.");
+                return 0;
+            }
+            if (scale < 1) {
+                PyErr_SetString(PyExc_RuntimeError, "Map.RenderToCanvas: scale must be at least 1.");
+                return 0;
+            }
+
+            return ::Script::Canvas::New(RenderMapToCanvas(engine->map, *engine->tiles, layers, area, scale));
+        }
+
 #undef METHOD
 #undef METHOD1
     }
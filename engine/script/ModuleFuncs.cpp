@@ -2,6 +2,7 @@
 #include "ObjectDefs.h"
 #include "main.h"
 #include "timer.h"
+#include "common/trace.h"
 #include "SDL/SDL.h"
 
 #define METHOD(x)  PyObject* x(PyObject* /*self*/, PyObject* args)
@@ -75,6 +76,101 @@ namespace Script {
         return PyLong_FromLong(engine->video->GetFrameRate());
     }
 
+    METHOD1(ika_getframestats) {
+        const FrameStats& stats = engine->frameStats;
+        PyObject* dict = PyDict_New();
+
+        for (int phase = 0; phase <= FrameStats::frame; phase++) {
+            const char* name = phase == FrameStats::frame ? "frame" : FrameStats::phaseNames[phase];
+            PyObject* times = Py_BuildValue("(ddd)",
+                stats.Percentile(phase, 0.50),
+                stats.Percentile(phase, 0.95),
+                stats.Percentile(phase, 0.99));
+            PyDict_SetItemString(dict, name, times);
+            Py_DECREF(times);
+        }
+
+        std::vector<uint> buckets;
+        stats.Histogram(buckets);
+        PyObject* histogram = PyList_New(buckets.size());
+        for (uint i = 0; i < buckets.size(); i++) {
+            PyList_SET_ITEM(histogram, i, PyLong_FromLong(buckets[i]));
+        }
+        PyDict_SetItemString(dict, "histogram", histogram);
+        Py_DECREF(histogram);
+
+        PyObject* count = PyLong_FromLong(stats.FrameCount());
+        PyDict_SetItemString(dict, "frames", count);
+        Py_DECREF(count);
+
+        return dict;
+    }
+
+    METHOD1(ika_getmemorystats) {
+        PyObject* dict = PyDict_New();
+
+        for (int i = 0; i < MemStats::numCategories; i++) {
+            MemStats::Category c = MemStats::Category(i);
+            PyObject* bytes = Py_BuildValue("(nn)", Py_ssize_t(MemStats::Current(c)), Py_ssize_t(MemStats::HighWater(c)));
+            PyDict_SetItemString(dict, MemStats::categoryNames[i], bytes);
+            Py_DECREF(bytes);
+        }
+
+        PyObject* total = Py_BuildValue("(nn)", Py_ssize_t(MemStats::Total()), Py_ssize_t(MemStats::TotalHighWater()));
+        PyDict_SetItemString(dict, "total", total);
+        Py_DECREF(total);
+
+        return dict;
+    }
+
+    METHOD(ika_enabletrace) {
+        int enable;
+
+        if (!PyArg_ParseTuple(args, "i:EnableTrace", &enable))
+            return 0;
+
+        Trace::Enable(enable != 0);
+
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    METHOD(ika_tracebegin) {
+        char* name;
+
+        if (!PyArg_ParseTuple(args, "s:TraceBegin", &name))
+            return 0;
+
+        if (Trace::IsEnabled()) {
+            Trace::Begin(Trace::Intern(name));
+        }
+
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    METHOD1(ika_traceend) {
+        Trace::End();
+
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    METHOD(ika_dumptrace) {
+        char* fileName;
+
+        if (!PyArg_ParseTuple(args, "s:DumpTrace", &fileName))
+            return 0;
+
+        if (!Trace::Dump(fileName)) {
+            PyErr_SetString(PyExc_IOError, va("Couldn't write trace to '%s'", fileName));
+            return 0;
+        }
+
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
     METHOD(ika_delay) {
         int ticks;
 
@@ -113,7 +209,7 @@ namespace Script {
             }
 
             engine->Render();
-            engine->video->ShowPage();
+            engine->ShowPage();
         }
 
         engine->player = pSaveplayer;                   // restore the player
@@ -462,6 +558,49 @@ namespace Script {
             "Returns the current engine framerate, in frames per second."
         },
 
+        { "GetFrameStats",  (PyCFunction)ika_getframestats,     METH_NOARGS,
+            "GetFrameStats() -> dict\n\n"
+            "Returns how long recent frames took, in milliseconds.\n"
+            "'frame' and each of 'input', 'tick', 'layers', 'entities', 'hooks',\n"
+            "'showpage' and 'other' map to a (50th, 95th, 99th) percentile tuple.\n"
+            "'histogram' is a list counting the frames that took 0, 1, 2... ms,\n"
+            "and 'frames' is how many frames the numbers are drawn from."
+        },
+
+        { "GetMemoryStats", (PyCFunction)ika_getmemorystats,    METH_NOARGS,
+            "GetMemoryStats() -> dict\n\n"
+            "Returns how much memory ika is using, in bytes.  Each of 'canvas',\n"
+            "'texture', 'texturepadding', 'map', 'aries', 'script' and 'total'\n"
+            "maps to a (current, high water) tuple.  'texturepadding' is texture\n"
+            "memory wasted rounding images up to a power of two.  'script' only\n"
+            "counts ika's own objects, not Python's."
+        },
+
+        { "EnableTrace",    (PyCFunction)ika_enabletrace,       METH_VARARGS,
+            "EnableTrace(enable)\n\n"
+            "Starts or stops recording a trace of what the engine is doing.\n"
+            "Running ika with --trace filename starts tracing at once, and writes\n"
+            "the trace to filename on exit."
+        },
+
+        { "TraceBegin",     (PyCFunction)ika_tracebegin,        METH_VARARGS,
+            "TraceBegin(name)\n\n"
+            "Starts a span in the trace.  Every TraceBegin must be matched by a\n"
+            "TraceEnd.  Does nothing while tracing is off."
+        },
+
+        { "TraceEnd",       (PyCFunction)ika_traceend,          METH_NOARGS,
+            "TraceEnd()\n\n"
+            "Ends the span started by the last TraceBegin."
+        },
+
+        { "DumpTrace",      (PyCFunction)ika_dumptrace,         METH_VARARGS,
+            "DumpTrace(filename)\n\n"
+            "Writes the trace recorded so far as Chrome trace event JSON, which\n"
+            "chrome://tracing and Perfetto can open.  Only the most recent events\n"
+            "are kept."
+        },
+
         { "Delay",          (PyCFunction)ika_delay,             METH_VARARGS,
             "Delay(time)\n\n"
             "Freezes the engine for a number of 'ticks'. (one tick is 1/100th of a second)"
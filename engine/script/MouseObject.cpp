@@ -48,14 +48,14 @@ namespace Script
 
         PyObject* New()
         {
-            PyObject* obj = PyObject_New(PyObject, &type);
+            PyObject* obj = NewObject<PyObject>(&type);
             assert(obj);
             return obj;
         }
 
         void Destroy(PyObject* self)
         {
-            PyObject_Del(self);
+            DelObject(self);
         }
     }
 }
@@ -84,7 +84,7 @@ namespace Script {
                 return 0;
             }
 
-            sound = PyObject_New(MusicObject, type);
+            sound = NewObject<MusicObject>(type);
             if (!sound) {
                 PyErr_SetString(PyExc_RuntimeError, va("Can't load %s due to internal Python weirdness!  Very Bad!", pathname.c_str()));
                 return 0;
@@ -101,7 +101,7 @@ namespace Script {
 
         void Destroy(MusicObject* self) {
             self->music->unref();
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(MusicObject* self)
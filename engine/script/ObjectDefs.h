@@ -8,9 +8,12 @@
 #include <sstream>
 #include <map>
 
+#include "common/memstats.h"
+
 // Rain of prototypes
 namespace Ika {  // X11/SDL fix
     struct Font;
+    struct TextLayout;
 }
 struct Entity;
 struct Engine;
@@ -38,6 +41,23 @@ struct ColourHandler;
 
 /// Contains implementations of Python binding things.
 namespace Script {
+    /// PyObject_New, but counted by MemStats.  Use DelObject to get rid of it.
+    template <typename T>
+    T* NewObject(PyTypeObject* type) {
+        T* obj = PyObject_New(T, type);
+        if (obj) {
+            MemStats::Allocate(MemStats::script, type->tp_basicsize);
+        }
+        return obj;
+    }
+
+    /// PyObject_Del, for objects made by NewObject.
+    template <typename T>
+    void DelObject(T* obj) {
+        MemStats::Free(MemStats::script, ((PyObject*)obj)->ob_type->tp_basicsize);
+        PyObject_Del(obj);
+    }
+
     // Hardware interfaces
     /// Reflects an image.
     namespace Image {
@@ -151,6 +171,7 @@ namespace Script {
         METHOD1(Canvas_AlphaMask, CanvasObject);
         METHOD(Canvas_Blit, CanvasObject);
         METHOD(Canvas_ScaleBlit, CanvasObject);
+        METHOD1(Canvas_MakeMipChain, CanvasObject);
         METHOD(Canvas_TileBlit, CanvasObject);
         METHOD(Canvas_GetPixel, CanvasObject);
         METHOD(Canvas_SetPixel, CanvasObject);
@@ -181,6 +202,8 @@ namespace Script {
         struct FontObject {
             PyObject_HEAD
             Ika::Font* font;
+            PyObject* images;               // Rendered strings, keyed by (text, colour, subset)
+            bool cacheStrings;              // If true, Print and friends draw from images
         };
 
         // Methods
@@ -189,6 +212,7 @@ namespace Script {
         METHOD(Font_RightPrint, FontObject);
         METHOD(Font_StringWidth, FontObject);
         METHOD(Font_StringHeight, FontObject);
+        METHOD(Font_RenderToImage, FontObject);
 
         void Init();
         PyObject* New(PyTypeObject* type, PyObject* args, PyObject* kw);
@@ -200,6 +224,28 @@ namespace Script {
         extern PyObject obj;
     }
 
+    /// A string laid out in a particular font, ready to be drawn.
+    namespace TextLayout {
+        // Object type
+        struct TextLayoutObject {
+            PyObject_HEAD
+            PyObject* font;                 // The Font object the text was laid out with.  Holds a reference.
+            Ika::TextLayout* layout;
+        };
+
+        // Methods
+        METHOD(TextLayout_Draw, TextLayoutObject);
+
+        void Init();
+        PyObject* New(PyTypeObject* type, PyObject* args, PyObject* kw);
+        void Destroy(TextLayoutObject* self);
+
+        // Method table
+        extern PyMethodDef methods[];
+        extern PyTypeObject type;
+        extern PyObject obj;
+    }
+
     /// Reflects a map entity.
     namespace Entity {
         // Object type
@@ -355,9 +401,12 @@ namespace Script {
         METHOD1(Video_GetClipRect, VideoObject);
         METHOD(Video_GrabImage, VideoObject);
         METHOD(Video_GrabCanvas, VideoObject);
+        METHOD(Video_GrabCanvasAsync, VideoObject);
+        METHOD(Video_SaveScreenshot, VideoObject);
         METHOD1(Video_ClearScreen, VideoObject);
         METHOD1(Video_ShowPage, VideoObject);
-        //METHOD(Video_RenderTo, VideoObject);
+        METHOD(Video_CreateRenderTarget, VideoObject);
+        METHOD(Video_RenderTo, VideoObject);
         METHOD(Video_SetResolution, VideoObject);
 
         void Init();
@@ -419,6 +468,7 @@ namespace Script {
         METHOD(Map_GetZones, PyObject);
         METHOD(Map_GetWaypoints, PyObject);
         METHOD(Map_GetAllEntities, PyObject);
+        METHOD(Map_RenderToCanvas, PyObject);
 
         void Init();
         PyObject* New();
@@ -488,6 +538,12 @@ namespace Script {
     METHOD1(ika_getcaption, PyObject);
     METHOD(ika_setcaption, PyObject);
     METHOD1(ika_getframerate, PyObject);
+    METHOD1(ika_getframestats, PyObject);
+    METHOD1(ika_getmemorystats, PyObject);
+    METHOD(ika_enabletrace, PyObject);
+    METHOD(ika_tracebegin, PyObject);
+    METHOD1(ika_traceend, PyObject);
+    METHOD(ika_dumptrace, PyObject);
     METHOD(ika_delay, PyObject);
     METHOD(ika_wait, PyObject);
     METHOD1(ika_gettime, PyObject);
@@ -72,7 +72,7 @@ namespace Script {
                     throw va("%s does not exist", filename);
                 }
 
-                sound = PyObject_New(SoundObject, type);
+                sound = NewObject<SoundObject>(type);
                 if (!sound) {
                     throw va("Can't load %s due to internal Python weirdness!  Very Bad!", filename);
                 }
@@ -92,7 +92,7 @@ namespace Script {
 
         void Destroy(SoundObject* self) {
             self->sound->unref();
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(SoundObject* self)
@@ -0,0 +1,108 @@
+/*
+Python text layout object
+*/
+
+#include "ObjectDefs.h"
+#include "font.h"
+#include "main.h"
+
+namespace Script {
+    namespace TextLayout {
+        PyObject obj;
+        PyTypeObject type;
+
+        PyMethodDef methods[] = {
+            {   (char*)"Draw",         (PyCFunction)TextLayout_Draw,       METH_VARARGS,
+                (char*)"TextLayout.Draw(x, y)\n\n"
+                "Draws the text with its upper left corner at (x, y)."
+            },
+            {   0,           0    }
+        };
+
+        inline Ika::Font* GetFont(TextLayoutObject* self) {
+            return ((Script::Font::FontObject*)self->font)->font;
+        }
+
+#define GET(x) PyObject* get ## x(TextLayoutObject* self)
+        GET(Width)         { return PyLong_FromLong(self->layout->width); }
+        GET(Height)        { return PyLong_FromLong(self->layout->height); }
+        GET(Font)          { Py_INCREF(self->font); return self->font; }
+#undef GET
+
+        PyGetSetDef properties[] = {
+            {   (char*)"width",         (getter)getWidth,        0,        (char*)"Gets the width of the text, in pixels."   },
+            {   (char*)"height",        (getter)getHeight,       0,        (char*)"Gets the height of the text, in pixels."  },
+            {   (char*)"font",          (getter)getFont,         0,        (char*)"Gets the font the text was laid out with."  },
+            {   0   }
+        };
+
+        void Init() {
+            memset(&type, 0, sizeof type);
+
+            obj.ob_refcnt = 1;
+            obj.ob_type = &PyType_Type;
+            type.tp_name = "TextLayout";
+            type.tp_basicsize = sizeof(TextLayoutObject);
+            type.tp_dealloc = (destructor)Destroy;
+            type.tp_methods = methods;
+            type.tp_getset = properties;
+            type.tp_doc = "ika.TextLayout(font, text[, wrapwidth])->TextLayout\n\n"
+                "Measures text in the font given and works out where each glyph goes,\n"
+                "so that it can be drawn over and over without doing it again.\n"
+                "If wrapwidth is given, the text is word wrapped to fit within that\n"
+                "many pixels.  Changing the font's spacing afterwards does not\n"
+                "affect existing layouts.";
+            type.tp_new = New;
+
+            PyType_Ready(&type);
+        }
+
+        PyObject* New(PyTypeObject* type, PyObject* args, PyObject* kw) {
+            static char* keywords[] = { (char*)"font", (char*)"text", (char*)"wrapwidth", 0 };
+            PyObject* font;
+            char* text;
+            int wrapWidth = 0;
+
+            if (!PyArg_ParseTupleAndKeywords(args, kw, "O!s|i:TextLayout", keywords, &Script::Font::type, &font, &text, &wrapWidth)) {
+                return 0;
+            }
+
+            TextLayoutObject* layout = NewObject<TextLayoutObject>(type);
+            if (!layout) {
+                return 0;
+            }
+
+            Py_INCREF(font);
+            layout->font = font;
+            layout->layout = new Ika::TextLayout;
+
+            GetFont(layout)->LayoutString(text, wrapWidth, *layout->layout);
+
+            return (PyObject*)layout;
+        }
+
+        void Destroy(TextLayoutObject* self) {
+            delete self->layout;
+            Py_DECREF(self->font);
+
+            DelObject(self);
+        }
+
+#define METHOD(x) PyObject* x(TextLayoutObject* self, PyObject* args)
+
+        METHOD(TextLayout_Draw) {
+            int x, y;
+
+            if (!PyArg_ParseTuple(args, "ii:TextLayout.Draw", &x, &y)) {
+                return 0;
+            }
+
+            GetFont(self)->PrintLayout(x, y, *self->layout);
+
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+
+#undef METHOD
+    }
+}
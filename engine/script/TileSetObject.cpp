@@ -61,14 +61,14 @@ namespace Script {
         }
 
         PyObject* New() {
-            PyObject* obj = PyObject_New(PyObject, &type);
+            PyObject* obj = NewObject<PyObject>(&type);
             assert(obj != 0);
             return obj;
         }
 
         void Destroy(TilesetObject* self) {
             // ???
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(TilesetObject* /*self*/, PyObject* args)
@@ -80,7 +80,12 @@ namespace Script {
                 return 0;
             }
 
-            engine->tiles->Save(fileName);
+            try {
+                engine->tiles->Save(fileName);
+            } catch (std::runtime_error err) {
+                PyErr_SetString(PyExc_IOError, err.what());
+                return 0;
+            }
 
             Py_INCREF(Py_None);
             return Py_None;
@@ -108,6 +113,7 @@ namespace Script {
 
             delete engine->tiles;
             engine->tiles = newTiles;
+            engine->InvalidateScreen();
 
             Py_INCREF(Py_None);
             return Py_None;
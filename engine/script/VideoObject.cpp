@@ -144,11 +144,42 @@ namespace Script {
                 "Grabs a rectangle from the screen, copies it to a canvas, and returns it."
             },
 
+            {   (char*)"GrabCanvasAsync", (PyCFunction)Video_GrabCanvasAsync, METH_VARARGS,
+                (char*)"GrabCanvasAsync(x1, y1, x2, y2, callback)\n\n"
+                "Like GrabCanvas, but doesn't wait for the video card to hand the pixels over.\n"
+                "callback is called with the canvas once they arrive, from ShowPage, usually a\n"
+                "frame or two later.  What gets grabbed is what's on the screen now.\n\n"
+                "Good for save game thumbnails, where GrabCanvas would make the game hitch."
+            },
+
+            {   (char*)"SaveScreenshot", (PyCFunction)Video_SaveScreenshot, METH_VARARGS,
+                (char*)"SaveScreenshot(filename)\n\n"
+                "Grabs the whole screen the same way as GrabCanvasAsync, and writes it to\n"
+                "filename as a PNG.  The file is written on another thread, so it may not\n"
+                "exist for a few frames.  Screenshots still being written when ika exits\n"
+                "are finished first."
+            },
+
             {   (char*)"ClearScreen",  (PyCFunction)Video_ClearScreen, METH_NOARGS,
                 (char*)"ClearScreen()\n\n"
                 "Clears the screen. (with blackness)"
             },
 
+            {   (char*)"CreateRenderTarget", (PyCFunction)Video_CreateRenderTarget, METH_VARARGS,
+                (char*)"CreateRenderTarget(width, height) -> image\n\n"
+                "Creates a transparent image that can be drawn on with RenderTo.  Raises\n"
+                "RuntimeError if the video driver can't make one."
+            },
+
+            {   (char*)"RenderTo",     (PyCFunction)Video_RenderTo, METH_VARARGS,
+                (char*)"RenderTo(image=None)\n\n"
+                "Sends all drawing to image, which must have come from CreateRenderTarget,\n"
+                "instead of the screen.  Coordinates and ClipScreen are relative to the image\n"
+                "while it's bound, and ClearScreen makes it transparent.  The image can be\n"
+                "blitted like any other, as soon as drawing goes back to the screen.\n\n"
+                "RenderTo() or RenderTo(None) goes back to the screen.  So does ShowPage."
+            },
+
             {   (char*)"ShowPage",     (PyCFunction)Video_ShowPage, METH_NOARGS,
                 (char*)"ShowPage()\n\n"
                 "Flips the back and front video buffers.  This must be called after the screen\n"
@@ -199,14 +230,14 @@ namespace Script {
         }
 
         PyObject* New(::Video::Driver* v) {
-            VideoObject* video = PyObject_New(VideoObject, &type);
+            VideoObject* video = NewObject<VideoObject>(&type);
             video->video = v;
 
             return (PyObject*)video;
         }
 
         void Destroy(VideoObject* self) {
-            PyObject_Del(self);
+            DelObject(self);
         }
 
 #define METHOD(x) PyObject* x(VideoObject* self, PyObject* args)
@@ -671,8 +702,85 @@ namespace Script {
             return ::Script::Canvas::New(c);
         }
 
+        METHOD(Video_GrabCanvasAsync) {
+            int x1, y1, x2, y2;
+            PyObject* callback;
+
+            if (!PyArg_ParseTuple(args, "iiiiO:Video.GrabCanvasAsync", &x1, &y1, &x2, &y2, &callback)) {
+                return 0;
+            }
+
+            if (!PyCallable_Check(callback)) {
+                PyErr_SetString(PyExc_TypeError, "GrabCanvasAsync needs a function to call with the canvas");
+                return 0;
+            }
+
+            engine->GrabCanvasAsync(x1, y1, x2, y2, ScriptObject(callback));
+
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+
+        METHOD(Video_SaveScreenshot) {
+            char* filename;
+
+            if (!PyArg_ParseTuple(args, "s:Video.SaveScreenshot", &filename)) {
+                return 0;
+            }
+
+            engine->SaveScreenshot(filename);
+
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+
         METHOD1(Video_ClearScreen) {
             self->video->ClearScreen();
+            engine->InvalidateScreen();
+
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+
+        METHOD(Video_CreateRenderTarget) {
+            int width, height;
+
+            if (!PyArg_ParseTuple(args, "ii:Video.CreateRenderTarget", &width, &height)) {
+                return 0;
+            }
+
+            ::Video::Image* i = self->video->CreateRenderTarget(width, height);
+            if (!i) {
+                PyErr_SetString(PyExc_RuntimeError, va("Unable to create a %i x %i render target", width, height));
+                return 0;
+            }
+
+            return ::Script::Image::New(i);
+        }
+
+        METHOD(Video_RenderTo) {
+            PyObject* target = Py_None;
+
+            if (!PyArg_ParseTuple(args, "|O:Video.RenderTo", &target)) {
+                return 0;
+            }
+
+            ::Video::Image* img = 0;
+            if (target != Py_None) {
+                if (!PyObject_TypeCheck(target, &Script::Image::type)) {
+                    PyErr_SetString(PyExc_TypeError, "RenderTo takes an image or None");
+                    return 0;
+                }
+                img = ((Script::Image::ImageObject*)target)->img;
+            }
+
+            if (!self->video->RenderTo(img)) {
+                PyErr_SetString(PyExc_RuntimeError, "That image isn't a render target.  Use Video.CreateRenderTarget to make one.");
+                return 0;
+            }
+
+            // Whatever the map renderer thinks is on the screen may not be, once something else has been drawn.
+            engine->InvalidateScreen();
 
             Py_INCREF(Py_None);
             return Py_None;
@@ -680,7 +788,7 @@ namespace Script {
 
         METHOD1(Video_ShowPage) {
             engine->CheckMessages();
-            self->video->ShowPage();
+            engine->ShowPage();
 
             Py_INCREF(Py_None);
             return Py_None;
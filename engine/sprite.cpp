@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cmath>
 
 #include "sprite.h"
 
@@ -8,7 +9,19 @@
 #include "video/Driver.h"
 #include "video/Image.h"
 
-Sprite::Sprite(const std::string& fname, Video::Driver* v) : video(v) {
+namespace {
+    // Frames are packed onto sheets no bigger than this.  Video cards that can't
+    // handle textures this size are not worth worrying about.
+    const int maxSheetSize = 1024;
+
+    // Transparent pixels left between frames, so that filtering doesn't bleed.
+    const int sheetGutter = 1;
+}
+
+Sprite::Sprite(const std::string& fname, Video::Driver* v)
+    : video(v)
+    , _textureMemory(0)
+{
     CCHRfile chr;
     chr.Load(fname);
         
@@ -33,11 +46,41 @@ Sprite::Sprite(const std::string& fname, Video::Driver* v) : video(v) {
         
         s = "idle_";    s += dirNames[i];   _idleScripts[i] = _scripts[s];
         s = "walk_";    s += dirNames[i];   _walkScripts[i] = _scripts[s];
+
+        if (!_idleScripts[i].empty()) _idlePrograms[i] = new AnimProgram(_idleScripts[i]);
+        if (!_walkScripts[i].empty()) _walkPrograms[i] = new AnimProgram(_walkScripts[i]);
     }
     
-    _frames.resize(chr.NumFrames());
-    for (uint i = 0; i < chr.NumFrames(); i++) {
-        _frames[i] = video->CreateImage(chr.GetFrame(i));
+    // Pack the frames onto as few sheets as possible, so that drawing lots of entities
+    // with the same sprite doesn't have to keep switching textures.
+    const int cellWidth = nFramex + sheetGutter;
+    const int cellHeight = nFramey + sheetGutter;
+    const int numFrames = chr.NumFrames();
+
+    // Roughly square sheets waste the least power-of-two padding.
+    int columns = (int)ceil(sqrt(double(numFrames) * cellHeight / cellWidth));
+    columns = max(1, min(columns, min(numFrames, maxSheetSize / cellWidth)));
+    int rows = max(1, min((numFrames + columns - 1) / columns, maxSheetSize / cellHeight));
+
+    const int perSheet = columns * rows;
+
+    _frames.resize(numFrames);
+    for (int first = 0; first < numFrames; first += perSheet) {
+        const int count = min(perSheet, numFrames - first);
+        const int sheetRows = (count + columns - 1) / columns;
+
+        Canvas sheet(min(count, columns) * cellWidth - sheetGutter, sheetRows * cellHeight - sheetGutter);
+        for (int i = 0; i < count; i++) {
+            Blitter::Blit(chr.GetFrame(first + i), sheet, (i % columns) * cellWidth, (i / columns) * cellHeight, Blitter::OpaqueBlend());
+        }
+
+        Video::Image* sheetImage = video->CreateImage(sheet);
+        _sheets.push_back(sheetImage);
+        _textureMemory += nextPowerOf2(sheet.Width()) * nextPowerOf2(sheet.Height()) * sizeof(RGBA);
+
+        for (int i = 0; i < count; i++) {
+            _frames[first + i] = video->CreateSubImage(sheetImage, (i % columns) * cellWidth, (i / columns) * cellHeight, nFramex, nFramey);
+        }
     }
 }
 
@@ -45,6 +88,8 @@ Sprite::~Sprite()
 {
     for (uint i = 0; i < _frames.size(); i++)
         video->FreeImage(_frames[i]);
+    for (uint i = 0; i < _sheets.size(); i++)
+        video->FreeImage(_sheets[i]);
 }
 
 const std::map<std::string, std::string>& Sprite::GetAllScripts() const
@@ -76,6 +121,20 @@ const std::string& Sprite::GetWalkScript(Direction dir)
     return _walkScripts[int(dir)];
 }
 
+AnimProgram* Sprite::GetIdleProgram(Direction dir) const
+{
+    assert(int(dir) >= 0 && int(dir) < 8);
+
+    return _idlePrograms[int(dir)].get();
+}
+
+AnimProgram* Sprite::GetWalkProgram(Direction dir) const
+{
+    assert(int(dir) >= 0 && int(dir) < 8);
+
+    return _walkPrograms[int(dir)].get();
+}
+
 Video::Image* Sprite::GetFrame(uint frame) const
 {
     if (frame < 0 || frame > _frames.size())
@@ -103,6 +162,8 @@ Sprite* SpriteController::Load(const std::string& fname, Video::Driver* video)
     s->ref();
     sprite[fname] = s;
 
+    Log::Write("Loaded sprite %s: %i frames on %i textures, %iK", fname.c_str(), s->Count(), s->TextureCount(), s->TextureMemory() / 1024);
+
     return s;
 }
 
@@ -121,6 +182,26 @@ void SpriteController::Free(Sprite* s)
         Log::Write("Unallocated sprite tried to release!!  \"%s\"", s->_fileName.c_str());
 }
 
+uint SpriteController::TextureMemory() const
+{
+    uint total = 0;
+    for (SpriteMap::const_iterator i = sprite.begin(); i != sprite.end(); i++)
+        total += i->second->TextureMemory();
+
+    return total;
+}
+
+void SpriteController::LogTextureMemory() const
+{
+    for (SpriteMap::const_iterator i = sprite.begin(); i != sprite.end(); i++)
+    {
+        const Sprite* s = i->second;
+        Log::Write("%-32s %4i frames %3i textures %6iK", s->_fileName.c_str(), s->Count(), s->TextureCount(), s->TextureMemory() / 1024);
+    }
+
+    Log::Write("%i sprites, %iK total", (int)sprite.size(), TextureMemory() / 1024);
+}
+
 SpriteController::~SpriteController()
 {
     for (SpriteMap::iterator i = sprite.begin(); i != sprite.end(); i++)
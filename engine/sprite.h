@@ -4,6 +4,7 @@
 #include "common/refcount.h"
 #include "common/types.h"
 #include "common/utility.h"
+#include "animscript.h"
 
 #include <map>
 
@@ -32,20 +33,29 @@ struct Sprite : RefCounted {
     inline uint Width()  const { return nFramex; }
     inline uint Height() const { return nFramey; }
 
+    inline uint TextureCount()  const { return _sheets.size(); }
+    inline uint TextureMemory() const { return _textureMemory; } ///< Bytes of video memory the frames take up (approximately)
+
     const std::map<std::string, std::string>& GetAllScripts() const;
     const std::string& GetScript(const std::string& name);
     const std::string& GetIdleScript(Direction dir);
     const std::string& GetWalkScript(Direction dir);
+    AnimProgram* GetIdleProgram(Direction dir) const;       ///< The idle script, already parsed.  0 if there isn't one.
+    AnimProgram* GetWalkProgram(Direction dir) const;       ///< Ditto for walking.
 
 private:
     std::map<std::string, std::string> _scripts;            ///< all move scripts
     std::string _walkScripts[8];                            ///< walking scripts
     std::string _idleScripts[8];                            ///< idle(standing) scripts
+    RefPtr<AnimProgram> _walkPrograms[8];                   ///< _walkScripts, parsed once for every entity to share
+    RefPtr<AnimProgram> _idlePrograms[8];                   ///< _idleScripts, likewise
     Video::Driver* video;
 
     uint nFramex, nFramey;                                  ///< frame size
 
-    std::vector<Video::Image*> _frames;                     ///< frame images
+    std::vector<Video::Image*> _frames;                     ///< frame images.  These are pieces of the sheets.
+    std::vector<Video::Image*> _sheets;                     ///< images the frames are packed onto
+    uint _textureMemory;
 };
 
 /**
@@ -57,6 +67,9 @@ struct SpriteController {
     Sprite* Load(const std::string& fname, Video::Driver* video); ///< loads a CHR file
     void Free(Sprite* s);                                  ///< releases a CHR file
 
+    uint TextureMemory() const;                            ///< Total video memory used by all loaded sprites
+    void LogTextureMemory() const;                         ///< Writes the video memory used by each sprite to the log
+
     ~SpriteController();
 
 private:
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <stdexcept>
 #include "tileset.h"
 #include "path.h"
@@ -9,14 +11,18 @@
 #include "video/Driver.h"
 #include "video/Image.h"
 
+bool Tileset::releaseCanvases = false;
+
 Tileset::Tileset(const std::string& fname, Video::Driver* v)
     : video(v)
+    , fileName(IkaPath::_game + fname)
     , animTimer(0)
+    , animStarted(false)
 {
     CDEBUG("ctileset::loadvsp");
     vsp = new VSP;
     
-    if (!vsp->Load(IkaPath::_game + fname)) {
+    if (!vsp->Load(fileName)) {
         throw std::runtime_error("Unable to load VSP file " + fname + "\n");
     }
     
@@ -41,9 +47,18 @@ Tileset::Tileset(const std::string& fname, Video::Driver* v)
         flipFlag[i] = false;
     }
 
+    // Strands that don't fit in the tileset would run off the end of tileIndex.  Turn them off.
     animstate = vsp->vspAnim;
-    for (uint j = 0; j < vsp->vspAnim.size(); j++) {
-        animstate[j].count = animstate[j].delay;  // Init the counter.
+    for (uint j = 0; j < animstate.size(); j++) {
+        if (animstate[j].finish >= frameCount) {
+            animstate[j].start = animstate[j].finish = 0;
+        }
+    }
+
+    if (releaseCanvases) {
+        vsp = 0;
+    } else {
+        Pack();
     }
 }
 
@@ -53,14 +68,49 @@ Tileset::~Tileset() {
     }
 }
 
-void Tileset::Save(const std::string& fileName) const {
-    vsp->Save(fileName);
+void Tileset::Save(const std::string& destName) const {
+    Source().Save(destName);
 }
 
-Video::Image* Tileset::GetTile(uint index) const {
-    if (hFrame.empty()) {
-        return 0;
+VSP& Tileset::Source() const {
+    if (!vsp) {
+        Log::Write("Reloading tileset %s", fileName.c_str());
+        vsp = new VSP;
+        if (!vsp->Load(fileName)) {
+            vsp = 0;
+            throw std::runtime_error("Unable to reload VSP file " + fileName);
+        }
     }
+    return *vsp;
+}
+
+void Tileset::Pack() const {
+    VSP& source = Source();
+
+    // Most tilesets, and all the old 8 bit ones, fit in one palette.
+    RefPtr<Palette> palette = new Palette;
+    for (uint i = 0; i < frameCount; i++) {
+        if (!palette->Add(source.GetTile(i))) {
+            palette = RefPtr<Palette>();
+            break;
+        }
+    }
+
+    uint size = 0;
+    packedTiles.clear();
+    packedTiles.reserve(frameCount);
+    for (uint i = 0; i < frameCount; i++) {
+        packedTiles.push_back(PackedCanvas(source.GetTile(i), palette.get()));
+        size += packedTiles.back().Size();
+    }
+
+    Log::Write("Packed %i tiles into %i KB (%i KB unpacked)",
+        frameCount, size / 1024, frameCount * frameWidth * frameHeight * sizeof(RGBA) / 1024);
+
+    vsp = 0;
+}
+
+uint Tileset::TranslateIndex(uint index) const {
     if (index < 0 || index >= tileIndex.size()) {
         index = 0;
     }
@@ -68,77 +118,103 @@ Video::Image* Tileset::GetTile(uint index) const {
     if (index < 0 || index >= tileIndex.size()) {
         index = 0;
     }
-    return hFrame[index];
+    return index;
 }
 
-void Tileset::UpdateAnimation(int time) {
-    int i = time - animTimer;  // How many ticks have elapsed?
-    animTimer = time;
-    if (i < 1) {  // Not very much, wait a little longer.
-        return;
+Video::Image* Tileset::GetTile(uint index) const {
+    if (hFrame.empty()) {
+        return 0;
     }
-    if (i > 100) {  // Hack.
-        i = 100;
+    return hFrame[TranslateIndex(index)];
+}
+
+const PackedCanvas& Tileset::GetTileCanvas(uint index) const {
+    if (packedTiles.empty()) {
+        Pack();
     }
-    while (i--) {
-        for (int j = 0; j < 100; j++) {
+    return packedTiles[TranslateIndex(index)];
+}
+
+/*
+ * Each strand changes every 'delay' ticks.  Rather than counting every strand
+ * down every tick, the strands sit in a heap ordered by when they next change,
+ * and only the ones that are due get looked at.  A strand that is due several
+ * times over (because the game was paused, say) is moved straight to where it
+ * should be.
+ */
+void Tileset::UpdateAnimation(int time) {
+    changedTiles.clear();
+
+    if (!animStarted) {
+        animStarted = true;
+        animTimer = time;
+        animQueue.clear();
+        for (uint j = 0; j < animstate.size(); j++) {
             if (animstate[j].start < animstate[j].finish) {
-                AnimateStrand(animstate[j]);
+                animQueue.push_back(AnimEvent(time + max(animstate[j].delay, 1), j));
             }
         }
+        std::make_heap(animQueue.begin(), animQueue.end(), std::greater<AnimEvent>());
+        return;
     }
-}
 
-void Tileset::AnimateStrand(VSP::AnimState& anim) {
-    anim.count--;
-    if (anim.count > 0) {
+    if (time <= animTimer) {
         return;
     }
-    switch (anim.mode) {
-        case VSP::linear: {
-            for (uint i = anim.start; i <= anim.finish; i++) {
-                tileIndex[i]++;
-                if (tileIndex[i] > anim.finish) {
-                    tileIndex[i] = anim.start;
-                }
-            }
-            break;
-        }
+    animTimer = time;
 
-        case VSP::reverse: {
-            for (uint i = anim.start; i <= anim.finish; i++) {
-                tileIndex[i]--;
-                if (tileIndex[i] < anim.start)
-                    tileIndex[i] = anim.finish;
-            }
-            break;
-        }
+    while (!animQueue.empty() && animQueue.front().first <= time) {
+        std::pop_heap(animQueue.begin(), animQueue.end(), std::greater<AnimEvent>());
+        AnimEvent& event = animQueue.back();
+        VSP::AnimState& anim = animstate[event.second];
 
-        case VSP::random: {
-            for (uint i = anim.start; i <= anim.finish; i++) {
-                tileIndex[i] = Random(int(anim.start), int(anim.finish + 1));
-            }
-            break;
-        }
+        const int period = max(anim.delay, 1);
+        const int steps = 1 + (time - event.first) / period;
+        AnimateStrand(anim, steps);
+
+        event.first += steps * period;
+        std::push_heap(animQueue.begin(), animQueue.end(), std::greater<AnimEvent>());
+    }
+}
 
-        case VSP::flip: {
-            for (uint i = anim.start; i <= anim.finish; i++) {
-                std::vector<bool>::reference flipped = flipFlag[i];
-                std::vector<uint>::reference index = tileIndex[i];
+void Tileset::AnimateStrand(VSP::AnimState& anim, int steps) {
+    const int length = anim.finish - anim.start + 1;
 
-                if (flipped && index <= anim.start) {
-                    flipped = false;
-                } else if (!flipped && index >= anim.finish) {
-                    flipped = true;
-                }
+    for (uint i = anim.start; i <= anim.finish; i++) {
+        uint old = tileIndex[i];
+        int pos = int(tileIndex[i] - anim.start);
+
+        switch (anim.mode) {
+            case VSP::linear:
+                tileIndex[i] = anim.start + (pos + steps) % length;
+                break;
 
-                if (flipped) {
-                    index--;
-                } else {
-                    index++;
+            case VSP::reverse:
+                tileIndex[i] = anim.start + ((pos - steps) % length + length) % length;
+                break;
+
+            case VSP::random:
+                tileIndex[i] = Random(int(anim.start), int(anim.finish + 1));
+                break;
+
+            case VSP::flip: {
+                // Going up and coming back down is one cycle of 2 * (length - 1) steps.
+                // Phases below length - 1 are on the way up.
+                const int span = length - 1;
+                int phase = flipFlag[i] ? 2 * span - pos : pos;
+                if (phase == 2 * span) {
+                    phase = 0;
                 }
+
+                phase = (phase + steps) % (2 * span);
+                flipFlag[i] = phase >= span;
+                tileIndex[i] = anim.start + (flipFlag[i] ? 2 * span - phase : phase);
+                break;
             }
-            break;
+        }
+
+        if (tileIndex[i] != old) {
+            changedTiles.push_back(i);
         }
     }
 
@@ -147,6 +223,4 @@ void Tileset::AnimateStrand(VSP::AnimState& anim) {
         assert(anim.start <= tileIndex[i] && tileIndex[i] <= anim.finish);
     }
 #endif
-
-    anim.count = anim.delay;
 }
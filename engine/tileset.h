@@ -3,6 +3,7 @@
 
 #include "common/utility.h"
 #include "common/vsp.h"
+#include "common/PackedCanvas.h"
 
 namespace Video {
     struct Driver;
@@ -21,6 +22,7 @@ struct Tileset {
     void Save(const std::string& fileName) const;
 
     Video::Image* GetTile(uint index) const;
+    const PackedCanvas& GetTileCanvas(uint index) const;   ///< The pixels of the tile, for drawing on canvases.  Animated, like GetTile.
 
     inline uint NumTiles() const { return frameCount; }  ///< Returns the number of tiles in the tileset.
 
@@ -28,10 +30,22 @@ struct Tileset {
     inline int Height() const { return frameHeight; }   ///< Height of the tiles in the tileset.
 
     void UpdateAnimation(int time);                     ///< Updates the animation state.  Pass the current time.
+    const std::vector<uint>& ChangedTiles() const { return changedTiles; }  ///< Tiles whose image changed in the last UpdateAnimation.
+
+    /// Tilesets keep a packed copy of their tiles, which is a quarter to half
+    /// the size of the original.  If this is true, they let go of that too, and
+    /// read the file again if they turn out to need it.
+    static bool releaseCanvases;
 
 private:
+    VSP& Source() const;                                ///< Returns the source tileset, loading it again if it was released.
+    void Pack() const;                                  ///< Fills packedTiles from the source tileset, and releases the source.
+    uint TranslateIndex(uint index) const;              ///< Applies animation to a tile index.
+
     Video::Driver* video;
-    ScopedPtr<VSP> vsp;                                 ///< Source tileset.
+    std::string fileName;                               ///< Where the source tileset came from.
+    mutable ScopedPtr<VSP> vsp;                         ///< Source tileset.  Null if it has been released.
+    mutable std::vector<PackedCanvas> packedTiles;      ///< The same pixels, in less room.
 
     std::vector<Video::Image*> hFrame;                  ///< Array of image handles.
     uint frameCount;                                    ///< Number of tiles in the tileset.
@@ -42,9 +56,13 @@ private:
     
     std::vector<VSP::AnimState>    animstate;           ///< Animation states for each tile
 
-    int animTimer;                                      ///< used by UpdateAnimation
+    typedef std::pair<int, uint> AnimEvent;             ///< When a strand next changes, and which strand it is.
+    std::vector<AnimEvent> animQueue;                   ///< Heap of strands, soonest first.
+    std::vector<uint> changedTiles;                     ///< See ChangedTiles
+    int animTimer;                                      ///< Time of the last UpdateAnimation
+    bool animStarted;                                   ///< false until the first UpdateAnimation
 
-    void AnimateStrand(VSP::AnimState& anim);           ///< Updates one tile's animation state.
+    void AnimateStrand(VSP::AnimState& anim, int steps);  ///< Moves a strand on by any number of frames at once.
 };
 
 #endif
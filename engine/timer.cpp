@@ -0,0 +1,3 @@
+#include "timer.h"
+
+int virtualTime = -1;
@@ -1,9 +1,22 @@
 #pragma once
 #include <SDL/SDL.h>
+#include "common/utility.h"
 
 // Ticks in a second.
 const int timeRate = 100;
 
-inline int GetTime() {
+// Set while recording or replaying an input journal, or running headless.  Negative means use the real clock.
+extern int virtualTime;
+
+/// The wall clock, in ticks.  Most things want GetTime instead.
+inline int GetRealTime() {
     return SDL_GetTicks() * timeRate / 1000;
 }
+
+inline int GetTime() {
+    if (virtualTime >= 0) {
+        return virtualTime;
+    }
+    return GetRealTime();
+}
+
@@ -50,9 +50,22 @@ namespace Video {
         /// Creates a new image from the provided pixel buffer.
         virtual Image* CreateImage(Canvas &pm) = 0;
 
+        /// Creates an image from a rectangular piece of another, sharing its storage.
+        /// The new image must be freed too, but it doesn't matter which is freed first.
+        virtual Image* CreateSubImage(Image* img, int x, int y, int w, int h) = 0;
+
         /// Frees the previously created image.
         virtual void FreeImage(Image* img) = 0;
 
+        /// Creates a blank (transparent) image that can be drawn on with RenderTo.
+        /// @returns 0 if the driver can't make one that size.
+        virtual Image* CreateRenderTarget(int width, int height) = 0;
+
+        /// Makes all drawing go to img instead of the screen, until RenderTo(0) or ShowPage.
+        /// Clipping and coordinates are relative to the image while it's bound.
+        /// @returns false if img wasn't made by CreateRenderTarget.
+        virtual bool RenderTo(Image* img) = 0;
+
         /// Clips the image to the provided rectangle.
         virtual void ClipScreen(int left, int top, int right, int bottom) = 0;
 
@@ -65,6 +78,16 @@ namespace Video {
         /// Clears the screen!  With blackness!
         virtual void ClearScreen() = 0;
 
+        /// Returns true if the screen keeps what was drawn on it after ShowPage.  The engine then
+        /// redraws only the parts of the map that changed.  Drivers that flip pages must say false.
+        virtual bool RetainsScreen() const = 0;
+
+        /// Called before the engine draws the map, with the parts of the screen it's about to
+        /// redraw, for drivers that only want to present (upload, copy to the window) what
+        /// changed.  Only called if RetainsScreen is true.  Whatever the driver is asked to draw
+        /// outside the map render is up to the driver to keep track of.
+        virtual void SetDirtyRegion(const std::vector<Rect>& rects) = 0;
+
         /// Sets the blending mode.
         /// @returns The old blending mode.
         virtual BlendMode SetBlendMode(BlendMode bm) = 0;
@@ -137,6 +160,17 @@ namespace Video {
         /// Like GrabImage, but stores the contents on a canvas, not an image
         virtual Canvas* GrabCanvas(int x1, int y1, int x2, int y2) = 0;
 
+        /// Starts a GrabCanvas without waiting for the pixels.  Whatever has been drawn so far
+        /// is what gets grabbed, but the copy finishes in the background, usually by the next
+        /// frame or the one after.
+        /// @returns A ticket for FinishGrabCanvas.
+        virtual uint BeginGrabCanvas(int x1, int y1, int x2, int y2) = 0;
+
+        /// Returns the canvas a BeginGrabCanvas asked for, or 0 if it isn't ready yet.  If wait
+        /// is true, it waits instead.  Once the canvas is returned (the caller owns it) the
+        /// ticket is used up.
+        virtual Canvas* FinishGrabCanvas(uint ticket, bool wait) = 0;
+
         /// Sets the current tint colour.  This tint is applied to *everything*
         virtual u32 GetTint() = 0;
 
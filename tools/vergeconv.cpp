@@ -0,0 +1,346 @@
+/*
+ * vergeconv: converts a whole tree of VERGE maps, tilesets, sprites and fonts
+ * to ika's current formats, several files at a time.
+ *
+ *     vergeconv sourcedir destdir [threads]
+ *
+ * Every file is written to the same relative path under destdir.  Maps become
+ * .ika-map files and CHRs become .ika-sprite files (entities in converted maps
+ * are pointed at the new sprite names).  VSPs and FNTs keep their names, and
+ * are rewritten as the current version of the format.  Anything else is left
+ * alone.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef WIN32
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <dirent.h>
+#endif
+
+#include "common/chr.h"
+#include "common/fontfile.h"
+#include "common/map.h"
+#include "common/thread.h"
+#include "common/utility.h"
+#include "common/vsp.h"
+
+extern Map* ImportVerge1Map(const std::string& fileName);
+extern Map* ImportVerge2Map(const std::string& fileName);
+extern Map* ImportVerge3Map(const std::string& fileName);
+extern VSP* ImportVerge3Tileset(const std::string& fileName);
+
+namespace {
+    enum Kind { mapFile, tilesetFile, spriteFile, fontFile, numKinds };
+    const char* const kindNames[numKinds] = { "maps", "tilesets", "sprites", "fonts" };
+
+    struct Job {
+        std::string path;       // relative to both directories
+        Kind kind;
+
+        // Filled in by Convert
+        std::string destPath;
+        bool ok;
+        std::string error;
+        uint inSize;
+        uint outSize;
+        double seconds;
+    };
+
+    bool BiggerFirst(const Job& a, const Job& b) {
+        return a.inSize > b.inSize;
+    }
+
+    bool ByPath(const Job& a, const Job& b) {
+        return a.path < b.path;
+    }
+
+    uint FileSize(const std::string& fileName) {
+        struct stat info;
+        return stat(fileName.c_str(), &info) == 0 ? uint(info.st_size) : 0;
+    }
+
+    bool IsDirectory(const std::string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+    }
+
+    /// True if both paths name the same directory, however they're spelled.
+    bool SameDirectory(const std::string& a, const std::string& b) {
+#ifdef WIN32
+        return Path::equals(a, b);
+#else
+        struct stat infoA, infoB;
+        return stat(a.c_str(), &infoA) == 0 && stat(b.c_str(), &infoB) == 0 &&
+            infoA.st_dev == infoB.st_dev && infoA.st_ino == infoB.st_ino;
+#endif
+    }
+
+    void MakeDirectory(const std::string& path) {
+#ifdef WIN32
+        CreateDirectory(path.c_str(), 0);
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    /// Lists the names in a directory, except . and ..
+    std::vector<std::string> ReadDirectory(const std::string& path) {
+        std::vector<std::string> names;
+
+#ifdef WIN32
+        WIN32_FIND_DATA data;
+        HANDLE find = FindFirstFile((path + "\\*").c_str(), &data);
+        if (find != INVALID_HANDLE_VALUE) {
+            do {
+                names.push_back(data.cFileName);
+            } while (FindNextFile(find, &data));
+            FindClose(find);
+        }
+#else
+        DIR* dir = opendir(path.c_str());
+        if (dir) {
+            while (dirent* entry = readdir(dir)) {
+                names.push_back(entry->d_name);
+            }
+            closedir(dir);
+        }
+#endif
+
+        names.erase(std::remove(names.begin(), names.end(), std::string(".")), names.end());
+        names.erase(std::remove(names.begin(), names.end(), std::string("..")), names.end());
+        return names;
+    }
+
+    /// Finds everything worth converting, and makes the matching directories under destRoot
+    /// as it goes, so the workers never have to.
+    void FindJobs(const std::string& sourceRoot, const std::string& destRoot, const std::string& dir, std::vector<Job>& jobs) {
+        const std::vector<std::string> names = ReadDirectory(sourceRoot + dir);
+
+        for (uint i = 0; i < names.size(); i++) {
+            const std::string path = dir + names[i];
+
+            if (IsDirectory(sourceRoot + path)) {
+                if (SameDirectory(sourceRoot + path + "/", destRoot)) {
+                    continue;       // converted files go here.  Walking into it would never end.
+                }
+                MakeDirectory(destRoot + path);
+                FindJobs(sourceRoot, destRoot, path + "/", jobs);
+                continue;
+            }
+
+            const std::string ext = toLower(Path::getExtension(path));
+            Job job;
+            job.path = path;
+            job.ok = false;
+            job.inSize = FileSize(sourceRoot + path);
+            job.outSize = 0;
+            job.seconds = 0;
+
+            if (ext == "map") {
+                job.kind = mapFile;
+            } else if (ext == "vsp") {
+                job.kind = tilesetFile;
+            } else if (ext == "chr") {
+                job.kind = spriteFile;
+            } else if (ext == "fnt") {
+                job.kind = fontFile;
+            } else {
+                continue;
+            }
+
+            jobs.push_back(job);
+        }
+    }
+
+    Map* ImportMap(const std::string& fileName) {
+        // Same order ikaMap tries them in.  Each throws something or returns 0 if the file isn't its version.
+        Map* (*importers[])(const std::string&) = { ImportVerge1Map, ImportVerge2Map, ImportVerge3Map };
+
+        for (uint i = 0; i < sizeof importers / sizeof importers[0]; i++) {
+            try {
+                if (Map* map = importers[i](fileName)) {
+                    return map;
+                }
+            } catch (...) {}
+        }
+
+        throw std::runtime_error("Not a VERGE 1, 2 or 3 map");
+    }
+
+    /// Converts one file.  Throws std::runtime_error if it can't.
+    void Convert(Job& job, const std::string& source, const std::string& dest) {
+        switch (job.kind) {
+            case mapFile: {
+                job.destPath = Path::replaceExtension(job.path, "ika-map");
+
+                ScopedPtr<Map> map(ImportMap(source));
+                for (uint i = 0; i < map->NumLayers(); i++) {
+                    std::vector<Map::Entity>& entities = map->GetLayer(i)->entities;
+                    for (uint j = 0; j < entities.size(); j++) {
+                        std::string& sprite = entities[j].spriteName;
+                        if (toLower(Path::getExtension(sprite)) == "chr") {
+                            sprite = Path::replaceExtension(sprite, "ika-sprite");
+                        }
+                    }
+                }
+                map->Save(Path::replaceExtension(dest, "ika-map"));
+                break;
+            }
+
+            case tilesetFile: {
+                job.destPath = job.path;
+
+                // VSP::Load handles v2 through v6, and ika's own format.  VERGE 3 tilesets need importing.
+                ScopedPtr<VSP> vsp(new VSP);
+                if (!vsp->Load(source)) {
+                    vsp = ImportVerge3Tileset(source);
+                }
+                if (!vsp->Save(dest)) {
+                    throw std::runtime_error("Unable to write the tileset");
+                }
+                break;
+            }
+
+            case spriteFile: {
+                job.destPath = Path::replaceExtension(job.path, "ika-sprite");
+
+                CCHRfile chr;
+                chr.Load(source);
+                chr.Save(Path::replaceExtension(dest, "ika-sprite"));
+                break;
+            }
+
+            case fontFile: {
+                job.destPath = job.path;
+
+                FontFile font;
+                if (!font.Load(source.c_str())) {
+                    throw std::runtime_error("Not a recognized font");
+                }
+                font.Save(dest.c_str());
+                break;
+            }
+
+            default:
+                assert(false);
+        }
+    }
+
+    struct ConvertTask : Parallel::Task {
+        std::vector<Job>& jobs;
+        const std::string sourceRoot;
+        const std::string destRoot;
+
+        ConvertTask(std::vector<Job>& j, const std::string& source, const std::string& dest)
+            : jobs(j)
+            , sourceRoot(source)
+            , destRoot(dest)
+        {}
+
+        virtual void Run(uint index) {
+            Job& job = jobs[index];
+            const double start = GetPreciseTime();
+
+            try {
+                Convert(job, sourceRoot + job.path, destRoot + job.path);
+                job.outSize = FileSize(destRoot + job.destPath);
+                job.ok = true;
+            } catch (std::exception& e) {
+                job.error = e.what();
+            } catch (const char* s) {
+                job.error = s;
+            } catch (...) {
+                job.error = "Unknown error";
+            }
+
+            job.seconds = GetPreciseTime() - start;
+        }
+    };
+
+    std::string WithSlash(const std::string& dir) {
+        if (!dir.empty() && Path::delimiters.find(dir[dir.length() - 1]) == std::string::npos) {
+            return dir + "/";
+        }
+        return dir;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Usage: vergeconv sourcedir destdir [threads]\n"
+               "Converts every VERGE map, VSP, CHR and FNT under sourcedir to ika's formats,\n"
+               "writing them to the same place under destdir.\n");
+        return 1;
+    }
+
+    const std::string sourceRoot = WithSlash(argv[1]);
+    const std::string destRoot = WithSlash(argv[2]);
+
+    if (!IsDirectory(sourceRoot)) {
+        printf("%s is not a directory.\n", argv[1]);
+        return 1;
+    }
+    if (Path::equals(destRoot.substr(0, sourceRoot.length()), sourceRoot)) {
+        printf("The destination can't be the source, or inside it.\n");
+        return 1;
+    }
+    if (argc > 3) {
+        Parallel::SetThreadCount(atoi(argv[3]));
+    }
+
+    MakeDirectory(destRoot);
+
+    std::vector<Job> jobs;
+    FindJobs(sourceRoot, destRoot, "", jobs);
+
+    // Start the big ones first, so that one huge map doesn't finish long after everything else.
+    std::sort(jobs.begin(), jobs.end(), BiggerFirst);
+
+    const double start = GetPreciseTime();
+    ConvertTask task(jobs, sourceRoot, destRoot);
+    Parallel::For(task, jobs.size());
+    const double wallTime = GetPreciseTime() - start;
+
+    std::sort(jobs.begin(), jobs.end(), ByPath);
+
+    uint files[numKinds + 1] = {0};
+    uint failed[numKinds + 1] = {0};
+    double inSize[numKinds + 1] = {0};
+    double outSize[numKinds + 1] = {0};
+    double seconds[numKinds + 1] = {0};
+
+    for (uint i = 0; i < jobs.size(); i++) {
+        const Job& job = jobs[i];
+        const int kinds[] = { job.kind, numKinds };     // its own line, and the total
+        for (uint k = 0; k < 2; k++) {
+            files[kinds[k]]++;
+            failed[kinds[k]] += job.ok ? 0 : 1;
+            inSize[kinds[k]] += job.inSize;
+            outSize[kinds[k]] += job.outSize;
+            seconds[kinds[k]] += job.seconds;
+        }
+
+        if (!job.ok) {
+            printf("FAILED %s: %s\n", job.path.c_str(), job.error.c_str());
+        }
+    }
+
+    printf("\n%-10s %7s %7s %10s %10s %9s\n", "", "files", "failed", "in KB", "out KB", "seconds");
+    for (uint k = 0; k <= numKinds; k++) {
+        printf("%-10s %7u %7u %10.0f %10.0f %9.2f\n",
+            k == numKinds ? "total" : kindNames[k],
+            files[k], failed[k], inSize[k] / 1024, outSize[k] / 1024, seconds[k]);
+    }
+    printf("\nTook %.2f seconds on %u threads.\n", wallTime, Parallel::ThreadCount());
+
+    return failed[numKinds] ? 2 : 0;
+}